@@ -0,0 +1,581 @@
+/*
+    HTTP负载生成器：
+    每个线程一个epoll循环，负责一部分连接，连接和请求速率平均分给各线程。
+    1.闭环模式(默认)：每个连接保持pipeline个未完成的请求，收到一个响应立即补发一个；
+    2.开环模式(-R rate)：请求按固定速率排定发送时刻，连接忙时在连接上排队，延迟从排定的时刻算起，
+      服务器变慢时不会像闭环模式那样自动少发请求而把排队时间藏起来(coordinated omission)；
+    3.-K关闭长连接：请求不带Connection: keep-alive，每个响应之后服务器关闭连接，客户端重新连接，延迟包含建立连接；
+    4.-i N额外打开N个只连接不发请求的空闲连接，被服务器超时关闭后重新连接，用来测试大量空闲连接下的延迟。
+    结束时输出吞吐量和p50/p99/p999延迟，-j把同样的结果以一行JSON追加到文件(-表示标准输出)，便于比较不同提交。
+
+    编译：g++ -std=c++17 -O2 bench/http_load.cpp -o http_load -lpthread
+    运行：./http_load [-c connections] [-t threads] [-d seconds] [-w warmup_seconds] [-p pipeline] [-R rate] [-K]
+                     [-i idle_connections] [-n name] [-l label] [-j file] ip port path
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+
+struct options
+{
+    const char * ip;
+    int port;
+    const char * path;
+    int connections;
+    int threads;
+    double duration;
+    double warmup;
+    int pipeline;
+    double rate;                    //每秒请求数，0表示闭环
+    bool keep_alive;
+    int idle;
+    const char * name;
+    const char * label;
+    const char * json;
+
+    options() : ip(NULL), port(0), path(NULL), connections(16), threads(1), duration(10), warmup(0), pipeline(1), rate(0),
+                keep_alive(true), idle(0), name("default"), label(""), json(NULL) {}
+};
+
+
+/* 每个线程的统计，结束后合并 */
+struct stats
+{
+    std::vector<uint32_t> latency;  //微秒
+    uint64_t responses;
+    uint64_t bytes;
+    uint64_t errors;                //连接失败或响应完成前连接断开时未完成的请求数
+    uint64_t connects;
+    uint64_t idle_reconnects;
+    uint64_t backlog;               //开环模式结束时还没有发出的请求数
+    uint64_t status[6];             //按状态码的百位计数，下标0为无法解析的状态行
+
+    stats() : responses(0), bytes(0), errors(0), connects(0), idle_reconnects(0), backlog(0), status() {}
+};
+
+
+struct connection
+{
+    int fd;
+    bool idle;                      //只连接不发请求
+    bool connected;
+    std::string out;                //还未发出的请求
+    size_t out_off;
+    std::string head;               //还不完整的响应头
+    int status;                     //当前响应的状态码
+    long body_left;
+    bool in_body;
+    bool closing;                   //当前响应带Connection: close
+    std::deque<uint64_t> inflight;  //已发出请求的起始时间(开环模式为排定的时刻)
+    std::deque<uint64_t> backlog;   //开环模式下已到发送时刻、等待连接空出的请求
+    uint64_t next_due;              //开环模式下一个请求的排定时刻
+
+    connection() : fd(-1), idle(false), connected(false), out_off(0), status(0), body_left(0), in_body(false), closing(false), next_due(0) {}
+};
+
+
+struct worker
+{
+    const options * opt;
+    int connections;
+    int idle;
+    double rate;
+    std::string request;
+    struct sockaddr_in address;
+    pthread_t thread;
+    stats st;
+};
+
+
+static uint64_t now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+class load_loop
+{
+    public:
+        explicit load_loop(worker * w) : m_worker(w), m_opt(w->opt), m_st(w->st), m_epollfd(epoll_create1(EPOLL_CLOEXEC)),
+                                         m_timerfd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {}
+        ~load_loop()
+        {
+            for(size_t i = 0; i < m_conns.size(); i++) if(m_conns[i].fd >= 0) close(m_conns[i].fd);
+            close(m_timerfd);
+            close(m_epollfd);
+        }
+
+        void run();
+
+    private:
+        void open_conn(size_t index);
+        void close_conn(size_t index, bool failed);
+        void fill(size_t index);                    //按模式把请求排入连接的发送缓冲
+        bool flush(size_t index);
+        bool receive(size_t index);
+        bool consume(size_t index, const char * data, size_t len);
+        void complete(size_t index, int status);
+        bool measuring() const { return m_now >= m_measure_begin; }
+
+    private:
+        static const size_t TIMER_EVENT = (size_t)-1;
+
+        worker * m_worker;
+        const options * m_opt;
+        stats & m_st;
+        int m_epollfd;
+        int m_timerfd;                              //开环模式下在下一个发送时刻唤醒epoll_wait
+        std::vector<connection> m_conns;
+        uint64_t m_now;
+        uint64_t m_measure_begin;
+        uint64_t m_interval;                        //开环模式下每个连接两次请求的间隔(微秒)
+        char m_buf[64 * 1024];
+};
+
+
+void load_loop::open_conn(size_t index)
+{
+    connection & c = m_conns[index];
+    c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(c.fd < 0)
+    {
+        perror("socket");
+        exit(1);
+    }
+    int on = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    c.connected = false;
+    c.out.clear();
+    c.out_off = 0;
+    c.head.clear();
+    c.in_body = false;
+    c.closing = false;
+    c.inflight.clear();
+
+    if(connect(c.fd, (struct sockaddr *)&m_worker->address, sizeof(m_worker->address)) < 0 && errno != EINPROGRESS)
+    {
+        close_conn(index, true);
+        return;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.u64 = index;
+    epoll_ctl(m_epollfd, EPOLL_CTL_ADD, c.fd, &ev);
+    if(!c.idle && measuring()) m_st.connects++;
+}
+
+
+/* 关闭后立即重新连接，未完成的请求计为错误；开环模式下排队的请求保留到新连接上发送 */
+void load_loop::close_conn(size_t index, bool failed)
+{
+    connection & c = m_conns[index];
+    if(c.fd >= 0) close(c.fd);
+    c.fd = -1;
+    if(c.idle)
+    {
+        if(measuring()) m_st.idle_reconnects++;
+    }
+    else if(measuring() && (failed || !c.inflight.empty())) m_st.errors += std::max<size_t>(c.inflight.size(), 1);
+    c.inflight.clear();
+}
+
+
+void load_loop::fill(size_t index)
+{
+    connection & c = m_conns[index];
+    if(c.idle || !c.connected) return;
+    size_t depth = m_opt->keep_alive ? m_opt->pipeline : 1;
+    if(m_interval)
+    {
+        while(!c.backlog.empty() && c.inflight.size() < depth)
+        {
+            c.inflight.push_back(c.backlog.front());
+            c.backlog.pop_front();
+            c.out += m_worker->request;
+        }
+    }
+    else
+    {
+        while(c.inflight.size() < depth)
+        {
+            c.inflight.push_back(m_now);
+            c.out += m_worker->request;
+        }
+    }
+}
+
+
+bool load_loop::flush(size_t index)
+{
+    connection & c = m_conns[index];
+    while(c.out_off < c.out.size())
+    {
+        ssize_t n = send(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off, MSG_NOSIGNAL);
+        if(n < 0)
+        {
+            if(errno == EAGAIN) return true;
+            return false;
+        }
+        c.out_off += n;
+    }
+    c.out.clear();
+    c.out_off = 0;
+    return true;
+}
+
+
+void load_loop::complete(size_t index, int status)
+{
+    connection & c = m_conns[index];
+    if(c.inflight.empty()) return;                  //服务器多发了响应，忽略
+    uint64_t begin = c.inflight.front();
+    c.inflight.pop_front();
+    if(begin < m_measure_begin) return;             //预热期间发出的请求不计入
+    uint64_t latency = m_now - begin;
+    m_st.latency.push_back(latency > UINT32_MAX ? UINT32_MAX : (uint32_t)latency);
+    m_st.responses++;
+    m_st.status[status >= 100 && status < 600 ? status / 100 : 0]++;
+}
+
+
+/* 响应体不复制，只累计剩余长度；响应头可能跨多次recv，拼接到head中 */
+bool load_loop::consume(size_t index, const char * data, size_t len)
+{
+    connection & c = m_conns[index];
+    if(measuring()) m_st.bytes += len;
+    while(len > 0)
+    {
+        if(c.in_body)
+        {
+            size_t n = std::min((size_t)c.body_left, len);
+            c.body_left -= n;
+            data += n;
+            len -= n;
+        }
+        else
+        {
+            size_t old = c.head.size();
+            c.head.append(data, len);
+            size_t end = c.head.find("\r\n\r\n", old >= 3 ? old - 3 : 0);
+            if(end == std::string::npos) return true;
+            size_t used = end + 4 - old;
+            data += used;
+            len -= used;
+
+            c.head.resize(end + 2);
+            c.status = 0;
+            if(c.head.compare(0, 9, "HTTP/1.1 ") == 0) c.status = atoi(c.head.c_str() + 9);
+            if(c.status == 0) return false;
+            c.body_left = 0;
+            c.closing = false;
+            size_t line = c.head.find("\r\n");
+            while(line != std::string::npos && line + 2 < c.head.size())
+            {
+                const char * h = c.head.c_str() + line + 2;
+                if(strncasecmp(h, "Content-Length:", 15) == 0) c.body_left = atol(h + 15);
+                else if(strncasecmp(h, "Connection:", 11) == 0) c.closing = strncasecmp(h + 11 + strspn(h + 11, " \t"), "close", 5) == 0;
+                line = c.head.find("\r\n", line + 2);
+            }
+            c.head.clear();
+            c.in_body = true;
+        }
+
+        if(c.in_body && c.body_left == 0)
+        {
+            c.in_body = false;
+            complete(index, c.status);
+            if(c.closing) return false;
+        }
+    }
+    return true;
+}
+
+
+bool load_loop::receive(size_t index)
+{
+    connection & c = m_conns[index];
+    while(true)
+    {
+        ssize_t n = recv(c.fd, m_buf, sizeof(m_buf), 0);
+        if(n < 0) return errno == EAGAIN;
+        if(n == 0) return false;
+        if(c.idle) continue;
+        if(!consume(index, m_buf, n)) return false;
+    }
+}
+
+
+void load_loop::run()
+{
+    m_now = now_us();
+    m_measure_begin = m_now + (uint64_t)(m_opt->warmup * 1e6);
+    uint64_t deadline = m_measure_begin + (uint64_t)(m_opt->duration * 1e6);
+    m_interval = m_worker->rate > 0 ? (uint64_t)(m_worker->connections * 1e6 / m_worker->rate) : 0;
+    if(m_worker->rate > 0 && m_interval == 0) m_interval = 1;
+
+    m_conns.resize(m_worker->connections + m_worker->idle);
+    for(size_t i = 0; i < m_conns.size(); i++)
+    {
+        m_conns[i].idle = (int)i >= m_worker->connections;
+        m_conns[i].next_due = m_now + (m_interval ? m_interval * i / m_worker->connections : 0);     //错开各连接的发送时刻
+        open_conn(i);
+    }
+
+    struct epoll_event events[1024];
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = TIMER_EVENT;
+    epoll_ctl(m_epollfd, EPOLL_CTL_ADD, m_timerfd, &ev);
+
+    while(m_now < deadline)
+    {
+        /*
+            开环模式：把已到时刻的请求排入各连接，用绝对时间的timerfd在下一个发送时刻唤醒epoll_wait。
+            epoll_wait的超时只精确到毫秒，不足1ms时忙等会在CPU少的机器上抢占服务器，测出的是负载生成器自己的排队
+        */
+        if(m_interval)
+        {
+            uint64_t next = deadline;
+            for(size_t i = 0; i < (size_t)m_worker->connections; i++)
+            {
+                connection & c = m_conns[i];
+                while(c.next_due <= m_now)
+                {
+                    c.backlog.push_back(c.next_due);
+                    c.next_due += m_interval;
+                }
+                next = std::min(next, c.next_due);
+                if(c.fd >= 0 && !c.backlog.empty())
+                {
+                    fill(i);
+                    if(!flush(i)) close_conn(i, true);
+                }
+            }
+            struct itimerspec due = {};
+            due.it_value.tv_sec = next / 1000000;
+            due.it_value.tv_nsec = next % 1000000 * 1000;
+            timerfd_settime(m_timerfd, TFD_TIMER_ABSTIME, &due, NULL);
+        }
+
+        int number = epoll_wait(m_epollfd, events, 1024, 100);
+        if(number < 0 && errno != EINTR)
+        {
+            perror("epoll_wait");
+            break;
+        }
+        m_now = now_us();
+        for(int i = 0; i < number; i++)
+        {
+            size_t index = events[i].data.u64;
+            if(index == TIMER_EVENT)
+            {
+                uint64_t expirations;
+                while(read(m_timerfd, &expirations, sizeof(expirations)) > 0) {}
+                continue;
+            }
+            connection & c = m_conns[index];
+            if(c.fd < 0) continue;
+            if(!c.connected && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+            {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if(err != 0)
+                {
+                    close_conn(index, true);
+                    continue;
+                }
+                c.connected = true;
+            }
+            bool ok = true;
+            if(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) ok = receive(index);
+            if(ok)
+            {
+                fill(index);
+                ok = flush(index);
+            }
+            if(!ok) close_conn(index, false);
+        }
+
+        /* 被关闭的连接(短连接模式下每个响应之后)重新连接 */
+        for(size_t i = 0; i < m_conns.size(); i++) if(m_conns[i].fd < 0) open_conn(i);
+    }
+
+    for(size_t i = 0; i < (size_t)m_worker->connections; i++) m_st.backlog += m_conns[i].backlog.size();
+}
+
+
+static void * worker_main(void * arg)
+{
+    worker * w = (worker *)arg;
+    load_loop loop(w);
+    loop.run();
+    return NULL;
+}
+
+
+static uint32_t percentile(const std::vector<uint32_t> & sorted, double q)
+{
+    if(sorted.empty()) return 0;
+    size_t rank = (size_t)(q * sorted.size());
+    if(rank >= sorted.size()) rank = sorted.size() - 1;
+    return sorted[rank];
+}
+
+
+static void usage(const char * prog)
+{
+    fprintf(stderr, "usage: %s [-c connections] [-t threads] [-d seconds] [-w warmup_seconds] [-p pipeline] [-R rate] [-K]\n"
+                    "       [-i idle_connections] [-n name] [-l label] [-j file] ip port path\n", prog);
+}
+
+
+int main(int argc, char * argv[])
+{
+    options opt;
+    int ch;
+    while((ch = getopt(argc, argv, "c:t:d:w:p:R:Ki:n:l:j:")) != -1)
+    {
+        switch(ch)
+        {
+            case 'c': opt.connections = atoi(optarg); break;
+            case 't': opt.threads = atoi(optarg); break;
+            case 'd': opt.duration = atof(optarg); break;
+            case 'w': opt.warmup = atof(optarg); break;
+            case 'p': opt.pipeline = atoi(optarg); break;
+            case 'R': opt.rate = atof(optarg); break;
+            case 'K': opt.keep_alive = false; break;
+            case 'i': opt.idle = atoi(optarg); break;
+            case 'n': opt.name = optarg; break;
+            case 'l': opt.label = optarg; break;
+            case 'j': opt.json = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(argc - optind < 3 || opt.connections <= 0 || opt.threads <= 0 || opt.threads > opt.connections || opt.duration <= 0
+       || opt.warmup < 0 || opt.pipeline <= 0 || opt.rate < 0 || opt.idle < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    opt.ip = argv[optind];
+    opt.port = atoi(argv[optind + 1]);
+    opt.path = argv[optind + 2];
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(opt.port);
+    if(inet_pton(AF_INET, opt.ip, &address.sin_addr) != 1)
+    {
+        fprintf(stderr, "bad address %s\n", opt.ip);
+        return 1;
+    }
+
+    /* 空闲连接洪泛需要大量fd */
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    std::string request = std::string("GET ") + opt.path + " HTTP/1.1\r\nHost: " + opt.ip + ":" + std::to_string(opt.port) + "\r\n";
+    if(opt.keep_alive) request += "Connection: keep-alive\r\n";
+    request += "\r\n";
+
+    std::vector<worker> workers(opt.threads);
+    for(int i = 0; i < opt.threads; i++)
+    {
+        worker & w = workers[i];
+        w.opt = &opt;
+        w.connections = opt.connections / opt.threads + (i < opt.connections % opt.threads);
+        w.idle = opt.idle / opt.threads + (i < opt.idle % opt.threads);
+        w.rate = opt.rate * w.connections / opt.connections;
+        w.request = request;
+        w.address = address;
+    }
+    for(int i = 0; i < opt.threads; i++)
+    {
+        if(pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0)
+        {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+
+    stats total;
+    for(int i = 0; i < opt.threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        stats & st = workers[i].st;
+        total.latency.insert(total.latency.end(), st.latency.begin(), st.latency.end());
+        total.responses += st.responses;
+        total.bytes += st.bytes;
+        total.errors += st.errors;
+        total.connects += st.connects;
+        total.idle_reconnects += st.idle_reconnects;
+        total.backlog += st.backlog;
+        for(int j = 0; j < 6; j++) total.status[j] += st.status[j];
+    }
+
+    std::sort(total.latency.begin(), total.latency.end());
+    double sum = 0;
+    for(size_t i = 0; i < total.latency.size(); i++) sum += total.latency[i];
+    double mean = total.latency.empty() ? 0 : sum / total.latency.size();
+    uint32_t p50 = percentile(total.latency, 0.5);
+    uint32_t p99 = percentile(total.latency, 0.99);
+    uint32_t p999 = percentile(total.latency, 0.999);
+    uint32_t max = total.latency.empty() ? 0 : total.latency.back();
+    double rps = total.responses / opt.duration;
+    double mbps = total.bytes / opt.duration / (1024 * 1024);
+
+    printf("%s: %d connections (%d idle), pipeline %d, keep-alive %s, %s\n", opt.name, opt.connections, opt.idle, opt.pipeline,
+           opt.keep_alive ? "on" : "off", opt.rate > 0 ? "open loop" : "closed loop");
+    printf("  %.0f requests/s, %.1f MB/s, %lu responses, %lu errors, %lu unsent\n", rps, mbps, (unsigned long)total.responses,
+           (unsigned long)total.errors, (unsigned long)total.backlog);
+    printf("  status 2xx %lu, 3xx %lu, 4xx %lu, 5xx %lu, other %lu\n", (unsigned long)total.status[2], (unsigned long)total.status[3],
+           (unsigned long)total.status[4], (unsigned long)total.status[5], (unsigned long)(total.status[0] + total.status[1]));
+    printf("  latency us: mean %.0f, p50 %u, p99 %u, p999 %u, max %u\n", mean, p50, p99, p999, max);
+
+    if(opt.json)
+    {
+        FILE * f = strcmp(opt.json, "-") == 0 ? stdout : fopen(opt.json, "a");
+        if(!f)
+        {
+            perror(opt.json);
+            return 1;
+        }
+        fprintf(f, "{\"name\":\"%s\",\"label\":\"%s\",\"path\":\"%s\",\"connections\":%d,\"idle\":%d,\"threads\":%d,\"pipeline\":%d,"
+                   "\"keep_alive\":%s,\"rate\":%.0f,\"duration\":%.1f,\"responses\":%lu,\"errors\":%lu,\"unsent\":%lu,"
+                   "\"requests_per_sec\":%.1f,\"mb_per_sec\":%.2f,\"status\":{\"2xx\":%lu,\"3xx\":%lu,\"4xx\":%lu,\"5xx\":%lu},"
+                   "\"latency_us\":{\"mean\":%.1f,\"p50\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u}}\n",
+                opt.name, opt.label, opt.path, opt.connections, opt.idle, opt.threads, opt.pipeline, opt.keep_alive ? "true" : "false",
+                opt.rate, opt.duration, (unsigned long)total.responses, (unsigned long)total.errors, (unsigned long)total.backlog,
+                rps, mbps, (unsigned long)total.status[2], (unsigned long)total.status[3], (unsigned long)total.status[4],
+                (unsigned long)total.status[5], mean, p50, p99, p999, max);
+        if(f != stdout) fclose(f);
+    }
+    return total.responses > 0 ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+/*
+    请求解析状态机的基准测试：
+    不经过socket，用read(data, len)把录制的请求数据放进连接的读缓冲区，直接驱动parse_line/parse_request_line/parse_headers/parse_content，
+    请求完整时停止而不调用do_request，测得的只是解析本身。每种输入分别按整块到达和按固定大小分片到达测量，
+    分片时每到达一片解析一次，覆盖行不完整(LINE_OPEN)后从断点继续的路径。输出每个请求的耗时(ns)和吞吐量(MB/s)。
+
+    编译：cmake -S . -B build && cmake --build build --target parser_bench
+    运行：./build/parser_bench [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+#include "../http_conn/http_conn.h"
+#include "../http_conn/http_scan.h"
+
+
+/* curl的默认请求 */
+static const char CURL[] =
+    "GET /index.html HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9006\r\n"
+    "User-Agent: curl/8.5.0\r\n"
+    "Accept: */*\r\n"
+    "\r\n";
+
+/* 浏览器请求，与scan_bench相同 */
+static const char BROWSER[] =
+    "GET /static/js/app.3f9a1c2b.bundle.js?version=20240517&locale=zh-CN HTTP/1.1\r\n"
+    "Host: www.example.com:8080\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Accept: */*\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Referer: https://www.example.com/articles/2024/05/high-performance-servers.html\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en-US;q=0.8,en;q=0.7\r\n"
+    "Cookie: session=9f8e7d6c5b4a39281706f5e4d3c2b1a0; theme=dark; _ga=GA1.1.123456789.1715900000\r\n"
+    "\r\n";
+
+/* http_load -p发出的流水线请求，一次到达MAX_PIPELINE个 */
+static const char PIPELINED[] =
+    "GET /tiny.html HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9006\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+/* 带消息体的请求，消息体不复制、直接丢弃 */
+static const char WITH_BODY[] =
+    "GET /index.html HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9006\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: 512\r\n"
+    "\r\n";
+
+
+/* http_conn的友元，按process_read()的流程解析，但请求完整时不调用do_request */
+class parser_bench
+{
+    public:
+        /* 解析读缓冲区中所有完整的请求，返回请求数，请求有误时返回-1 */
+        static int parse(http_conn & conn);
+
+        /* 按chunk大小分片送入数据，每片之后解析并压缩读缓冲区，与process()处理一批数据后相同 */
+        static int feed(http_conn & conn, const std::string & data, size_t chunk);
+
+    private:
+        static http_conn::HTTP_CODE parse_one(http_conn & conn);
+};
+
+
+http_conn::HTTP_CODE parser_bench::parse_one(http_conn & conn)
+{
+    http_conn::HTTP_CODE ret = http_conn::NO_REQUEST;
+    http_conn::LINE_STATUS line_status = http_conn::LINE_OK;
+
+    while((conn.m_check_state == http_conn::CHECK_STATE_CONTENT && line_status == http_conn::LINE_OK)
+          || ((line_status = conn.parse_line()) == http_conn::LINE_OK))
+    {
+        if(conn.m_check_state != http_conn::CHECK_STATE_CONTENT && conn.m_check_idx - conn.m_request_start > http_conn::m_header_limit)
+            return http_conn::HEADER_TOO_LARGE;
+        char * text = conn.get_line();
+        conn.m_start_line = conn.m_check_idx;
+
+        switch(conn.m_check_state)
+        {
+            case http_conn::CHECK_STATE_REQUESTLINE:
+            {
+                ret = conn.parse_request_line(text);
+                if(ret == http_conn::BAD_REQUEST) return ret;
+                break;
+            }
+            case http_conn::CHECK_STATE_HEADER:
+            {
+                ret = conn.parse_headers(text);
+                if(ret == http_conn::BAD_REQUEST || ret == http_conn::GET_REQUEST) return ret;
+                break;
+            }
+            case http_conn::CHECK_STATE_CONTENT:
+            {
+                ret = conn.parse_content(text);
+                if(ret == http_conn::GET_REQUEST) return ret;
+                line_status = http_conn::LINE_OPEN;
+                break;
+            }
+        }
+    }
+    return line_status == http_conn::LINE_BAD ? http_conn::BAD_REQUEST : http_conn::NO_REQUEST;
+}
+
+
+int parser_bench::parse(http_conn & conn)
+{
+    int requests = 0;
+    while(true)
+    {
+        http_conn::HTTP_CODE ret = parse_one(conn);
+        if(ret == http_conn::NO_REQUEST) return requests;
+        if(ret != http_conn::GET_REQUEST) return -1;
+
+        requests++;
+        conn.m_start_line = conn.m_check_idx;
+        conn.m_request_start = conn.m_check_idx;
+        conn.init_request();
+    }
+}
+
+
+int parser_bench::feed(http_conn & conn, const std::string & data, size_t chunk)
+{
+    int requests = 0;
+    size_t offset = 0;
+    while(offset < data.size())
+    {
+        int copied = conn.read(data.data() + offset, (int)std::min(chunk, data.size() - offset));
+        if(copied == 0) return -1;                  //一个请求超过了最大的读缓冲块
+        offset += copied;
+
+        int n = parse(conn);
+        if(n < 0) return -1;
+        requests += n;
+        conn.compact();
+    }
+    conn.init();
+    return requests;
+}
+
+
+static void run(const char * name, const std::string & data, int expected, size_t chunk, long iterations)
+{
+    http_conn conn;
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    conn.init(-1, address, -1);
+
+    long requests = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for(long i = 0; i < iterations; i++)
+    {
+        int n = parser_bench::feed(conn, data, chunk);
+        if(n != expected)
+        {
+            fprintf(stderr, "%s: parsed %d requests, expected %d\n", name, n, expected);
+            exit(1);
+        }
+        requests += n;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+
+    char label[64];
+    if(chunk >= data.size()) snprintf(label, sizeof(label), "%s", name);
+    else snprintf(label, sizeof(label), "%s/%zuB", name, chunk);
+    printf("%-18s %6zu bytes %8.1f ns/request %8.1f MB/s\n", label, data.size(), ns / requests, data.size() * iterations * 1e3 / ns);
+}
+
+
+int main(int argc, char * argv[])
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    printf("%ld iterations per case, scanner: %s\n", iterations, g_scan->name);
+
+    std::string pipelined;
+    for(int i = 0; i < http_conn::MAX_PIPELINE; i++) pipelined += PIPELINED;
+    std::string with_body = std::string(WITH_BODY) + std::string(512, 'x');
+
+    struct input { const char * name; std::string data; int requests; long iterations; };
+    input inputs[] = {
+        { "curl", CURL, 1, iterations },
+        { "browser", BROWSER, 1, iterations },
+        { "pipeline16", pipelined, http_conn::MAX_PIPELINE, iterations / http_conn::MAX_PIPELINE },
+        { "body512", with_body, 1, iterations },
+    };
+    const size_t chunks[] = { SIZE_MAX, 64, 1 };
+
+    for(const input & in : inputs)
+    {
+        for(size_t chunk : chunks)
+        {
+            long n = chunk == 1 ? in.iterations / 20 : in.iterations;     //每字节解析一次的情况慢得多
+            run(in.name, in.data, in.requests, chunk, n > 0 ? n : 1);
+        }
+    }
+    return 0;
+}
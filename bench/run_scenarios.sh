@@ -0,0 +1,55 @@
+#!/bin/sh
+# 端到端基准：在临时文档根目录下启动服务器，用http_load依次跑各个场景，每个场景的结果以一行JSON追加到结果文件，
+# 每行带当前提交的短哈希(label)，不同提交的结果追加到同一个文件里即可逐行比较。
+#
+# 用法：bench/run_scenarios.sh [results.jsonl]
+# 环境变量：SERVER、HTTP_LOAD 两个可执行文件的路径，默认取当前目录下的./server和./http_load
+#          SERVER_ARGS 传给服务器的额外参数(如"-r 4")，PORT 端口(默认9006)
+#          DURATION 每个场景的秒数(默认10)，WARMUP 预热秒数(默认1)，CONNECTIONS 连接数(默认64)，THREADS 负载线程数(默认2)
+#          RATE 开环场景的每秒请求数(默认20000)，IDLE 空闲连接洪泛场景的空闲连接数(默认5000)
+
+set -e
+
+RESULTS=$(realpath -m "${1:-bench-results.jsonl}")
+SERVER=$(realpath "${SERVER:-./server}")
+HTTP_LOAD=$(realpath "${HTTP_LOAD:-./http_load}")
+PORT=${PORT:-9006}
+DURATION=${DURATION:-10}
+WARMUP=${WARMUP:-1}
+CONNECTIONS=${CONNECTIONS:-64}
+THREADS=${THREADS:-2}
+RATE=${RATE:-20000}
+IDLE=${IDLE:-5000}
+LABEL=$(git -C "$(dirname "$0")" rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+# 服务器的文档根目录是工作目录，在临时目录中准备文件后切换过去
+ROOT=$(mktemp -d)
+trap 'kill $SERVER_PID 2>/dev/null; rm -rf "$ROOT"' EXIT INT TERM
+printf '<html><body>tiny</body></html>\n' > "$ROOT/tiny.html"
+head -c 1048576 /dev/urandom > "$ROOT/1m.bin"
+cd "$ROOT"
+
+ulimit -n "$(ulimit -Hn)" 2>/dev/null || true
+"$SERVER" $SERVER_ARGS 127.0.0.1 "$PORT" > server.log 2>&1 &
+SERVER_PID=$!
+sleep 0.5
+if ! kill -0 $SERVER_PID 2>/dev/null; then
+    cat server.log
+    exit 1
+fi
+
+run() {
+    name=$1
+    shift
+    "$HTTP_LOAD" -c "$CONNECTIONS" -t "$THREADS" -d "$DURATION" -w "$WARMUP" -n "$name" -l "$LABEL" -j "$RESULTS" "$@"
+}
+
+run tiny                                        127.0.0.1 "$PORT" /tiny.html
+run tiny-pipeline-8     -p 8                    127.0.0.1 "$PORT" /tiny.html
+run tiny-close          -K                      127.0.0.1 "$PORT" /tiny.html
+run 1m                                          127.0.0.1 "$PORT" /1m.bin
+run 404-storm                                   127.0.0.1 "$PORT" /missing.html
+run idle-flood          -i "$IDLE"              127.0.0.1 "$PORT" /tiny.html
+run tiny-open-loop      -R "$RATE"              127.0.0.1 "$PORT" /tiny.html
+
+echo "results appended to $RESULTS"
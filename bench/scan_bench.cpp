@@ -0,0 +1,206 @@
+/*
+    请求行和请求头扫描的基准测试：
+    用典型的浏览器请求(约700字节、12个头部)比较原来的逐字节循环 + strpbrk/strspn/strncasecmp
+    与http_scan中标量、SSE4.2、AVX2三种实现，输出每个请求的耗时(ns)和吞吐量(GB/s)。
+
+    编译：g++ -std=c++17 -O2 bench/scan_bench.cpp http_conn/http_scan.cpp -o scan_bench
+    运行：./scan_bench [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <chrono>
+
+#include "../http_conn/http_scan.h"
+
+
+static const char REQUEST[] =
+    "GET /static/js/app.3f9a1c2b.bundle.js?version=20240517&locale=zh-CN HTTP/1.1\r\n"
+    "Host: www.example.com:8080\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Accept: */*\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Referer: https://www.example.com/articles/2024/05/high-performance-servers.html\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en-US;q=0.8,en;q=0.7\r\n"
+    "Cookie: session=9f8e7d6c5b4a39281706f5e4d3c2b1a0; theme=dark; _ga=GA1.1.123456789.1715900000\r\n"
+    "\r\n";
+
+static const size_t REQUEST_LEN = sizeof(REQUEST) - 1;
+
+
+/* 解析结果，防止编译器把解析过程优化掉 */
+struct result
+{
+    const char * url;
+    const char * host;
+    long content_length;
+    bool keep_alive;
+    int headers;
+};
+
+
+/* 原来的实现：逐字节找行结束符，strpbrk/strspn切分请求行，strncasecmp逐个尝试头部名称 */
+static bool parse_baseline(char * buf, size_t len, result & r)
+{
+    size_t start = 0, check = 0;
+    bool request_line = true;
+    memset(&r, 0, sizeof(r));
+    while(check < len)
+    {
+        for(; check < len; check++) if(buf[check] == '\r' || buf[check] == '\n') break;
+        if(check + 1 >= len || buf[check] != '\r' || buf[check + 1] != '\n') return false;
+        buf[check++] = '\0';
+        buf[check++] = '\0';
+        char * text = buf + start;
+        start = check;
+
+        if(request_line)
+        {
+            char * url = strpbrk(text, " \t");
+            if(!url) return false;
+            *url++ = '\0';
+            if(strcasecmp(text, "GET") != 0) return false;
+            url += strspn(url, " \t");
+            char * version = strpbrk(url, " \t");
+            if(!version) return false;
+            *version++ = '\0';
+            version += strspn(version, " \t");
+            if(strcasecmp(version, "HTTP/1.1") != 0) return false;
+            r.url = url;
+            request_line = false;
+            continue;
+        }
+        if(text[0] == '\0') return true;
+        r.headers++;
+        if(strncasecmp(text, "Connection:", 11) == 0)
+        {
+            text += 11;
+            text += strspn(text, " \t");
+            r.keep_alive = strcasecmp(text, "keep-alive") == 0;
+        }
+        else if(strncasecmp(text, "Content-Length:", 15) == 0)
+        {
+            text += 15;
+            text += strspn(text, " \t");
+            r.content_length = atol(text);
+        }
+        else if(strncasecmp(text, "Host:", 5) == 0)
+        {
+            text += 5;
+            text += strspn(text, " \t");
+            r.host = text;
+        }
+    }
+    return false;
+}
+
+
+static char * skip_blank(char * p, const char * end)
+{
+    while(p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+
+/* 与http_conn相同的解析方式：向量化查找行结束符和分隔符，头部名称先比较长度 */
+static bool parse_scan(const scan_ops * ops, char * buf, size_t len, result & r)
+{
+    char * p = buf;
+    char * end = buf + len;
+    bool request_line = true;
+    memset(&r, 0, sizeof(r));
+    while(p < end)
+    {
+        char * eol = (char *)ops->eol(p, end);
+        if(eol + 1 >= end || eol[0] != '\r' || eol[1] != '\n') return false;
+        eol[0] = eol[1] = '\0';
+        char * text = p;
+        p = eol + 2;
+
+        if(request_line)
+        {
+            char * url = (char *)ops->any2(text, eol, ' ', '\t');
+            if(url == eol) return false;
+            *url++ = '\0';
+            if(strcasecmp(text, "GET") != 0) return false;
+            url = skip_blank(url, eol);
+            char * version = (char *)ops->any2(url, eol, ' ', '\t');
+            if(version == eol) return false;
+            *version++ = '\0';
+            version = skip_blank(version, eol);
+            if(strcasecmp(version, "HTTP/1.1") != 0) return false;
+            r.url = url;
+            request_line = false;
+            continue;
+        }
+        if(text == eol) return true;
+        r.headers++;
+        char * colon = (char *)ops->any2(text, eol, ':', ':');
+        if(colon == eol) return false;
+        int name_len = colon - text;
+        char * value = skip_blank(colon + 1, eol);
+        if(name_len == 10 && strncasecmp(text, "Connection", 10) == 0) r.keep_alive = strcasecmp(value, "keep-alive") == 0;
+        else if(name_len == 14 && strncasecmp(text, "Content-Length", 14) == 0) r.content_length = atol(value);
+        else if(name_len == 4 && strncasecmp(text, "Host", 4) == 0) r.host = value;
+    }
+    return false;
+}
+
+
+/* 每次解析前恢复请求内容(解析会写入'\0')，恢复的耗时单独测出后扣除 */
+template<typename F>
+static double run(const char * name, long iterations, double copy_ns, F parse)
+{
+    static char buf[sizeof(REQUEST)];
+    result r;
+    long checksum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for(long i = 0; i < iterations; i++)
+    {
+        memcpy(buf, REQUEST, REQUEST_LEN);
+        if(!parse(buf, REQUEST_LEN, r))
+        {
+            fprintf(stderr, "%s: parse failed\n", name);
+            exit(1);
+        }
+        checksum += r.headers + r.keep_alive + (r.host - buf) + (r.url - buf);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations - copy_ns;
+    if(name) printf("%-10s %8.1f ns/request %6.2f GB/s (checksum %ld)\n", name, ns, REQUEST_LEN / ns, checksum);
+    return ns;
+}
+
+
+int main(int argc, char * argv[])
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 2000000;
+    printf("request %zu bytes, %ld iterations, default scanner: %s\n", REQUEST_LEN, iterations, g_scan->name);
+
+    /* 只拷贝不解析的耗时 */
+    double copy_ns = run(NULL, iterations, 0, [](char * buf, size_t len, result & r) {
+        r.headers = buf[len - 1]; r.host = r.url = buf; return true; });
+
+    run("baseline", iterations, copy_ns, parse_baseline);
+
+    const char * names[] = { "scalar", "sse4.2", "avx2" };
+    for(const char * name : names)
+    {
+        const scan_ops * ops = scan_select(name);
+        if(!ops)
+        {
+            printf("%-10s not supported on this CPU\n", name);
+            continue;
+        }
+        run(name, iterations, copy_ns, [ops](char * buf, size_t len, result & r) { return parse_scan(ops, buf, len, r); });
+    }
+    return 0;
+}
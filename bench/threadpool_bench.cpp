@@ -0,0 +1,126 @@
+/*
+    线程池的基准测试：
+    1.吞吐量：一个生产者连续append空任务，队列满时让出CPU重试，测量全部任务执行完毕的耗时，
+      分别测试无锁队列(mpmc_queue)、加锁队列(locked_queue)和工作窃取模式，线程数从1倍增到max_threads；
+    2.唤醒延迟：每隔1ms投递一个任务，此时工作线程已自旋结束进入睡眠，测量从append到process()开始执行的耗时，
+      即信号量唤醒加调度的延迟，输出p50/p99/最大值。
+    任务不读时钟以外的任何数据，测得的是队列和唤醒本身的开销。
+
+    编译：cmake -S . -B build && cmake --build build --target threadpool_bench
+    运行：./build/threadpool_bench [tasks] [max_threads]
+*/
+
+/* 线程池创建线程时的INFO日志不混入结果 */
+#define LOG_LEVEL LOG_LEVEL_WARN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "../threadpool/threadpool.h"
+
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/* 满足threadpool对任务类型的要求：process()、set_queued()和queued() */
+struct task
+{
+    uint64_t posted;                //append之前的时间(ns)，0表示不统计唤醒延迟
+    uint64_t latency;
+    uint64_t queued_at;
+
+    static std::atomic<long> done;
+
+    void process()
+    {
+        if(posted) latency = now_ns() - posted;
+        done.fetch_add(1, std::memory_order_release);
+    }
+    void set_queued(uint64_t us) { queued_at = us; }
+    uint64_t queued() const { return queued_at; }
+};
+
+std::atomic<long> task::done(0);
+
+
+static const int MAX_REQUESTS = 10000;              //与main.cpp创建线程池时的队列容量相同
+
+
+template<typename Queue>
+static void throughput(const char * name, int threads, bool work_stealing, std::vector<task> & tasks)
+{
+    threadpool<task, Queue> pool(threads, MAX_REQUESTS, work_stealing);
+    task::done.store(0);
+    long rejected = 0;
+
+    uint64_t begin = now_ns();
+    for(task & t : tasks)
+    {
+        t.posted = 0;
+        while(!pool.append(&t))
+        {
+            rejected++;
+            sched_yield();
+        }
+    }
+    while(task::done.load(std::memory_order_acquire) < (long)tasks.size()) sched_yield();
+    double ns = now_ns() - begin;
+
+    printf("%-14s %2d threads %8.1f ns/task %8.2f Mtasks/s  queue full %ld\n", name, threads, ns / tasks.size(), tasks.size() * 1e3 / ns, rejected);
+}
+
+
+static void wakeup(int threads, int samples)
+{
+    threadpool<task> pool(threads, MAX_REQUESTS);
+    std::vector<task> tasks(samples);
+    task::done.store(0);
+    usleep(10000);                  //等所有线程进入睡眠
+
+    for(int i = 0; i < samples; i++)
+    {
+        tasks[i].posted = now_ns();
+        pool.append(&tasks[i]);
+        while(task::done.load(std::memory_order_acquire) <= i) sched_yield();
+        usleep(1000);
+    }
+
+    std::vector<uint64_t> latency;
+    for(const task & t : tasks) latency.push_back(t.latency);
+    std::sort(latency.begin(), latency.end());
+    printf("wakeup         %2d threads  p50 %7.1f us  p99 %7.1f us  max %7.1f us\n", threads,
+           latency[samples / 2] / 1e3, latency[std::min<size_t>(samples * 99 / 100, samples - 1)] / 1e3, latency.back() / 1e3);
+}
+
+
+int main(int argc, char * argv[])
+{
+    long count = argc > 1 ? atol(argv[1]) : 1000000;
+    int max_threads = argc > 2 ? atoi(argv[2]) : 8;
+    if(count <= 0 || max_threads <= 0)
+    {
+        printf("usage: %s [tasks] [max_threads]\n", argv[0]);
+        return 1;
+    }
+    printf("%ld tasks, queue capacity %d, %ld CPUs\n", count, MAX_REQUESTS, sysconf(_SC_NPROCESSORS_ONLN));
+
+    std::vector<task> tasks(count);
+    for(int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        throughput<mpmc_queue<task> >("mpmc", threads, false, tasks);
+        throughput<locked_queue<task> >("locked", threads, false, tasks);
+        throughput<mpmc_queue<task> >("work-stealing", threads, true, tasks);
+    }
+    for(int threads = 1; threads <= max_threads; threads *= 2) wakeup(threads, 500);
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+    定时器的基准测试，取代原来手工运行的test_timer.cpp：
+    模拟connections个长连接的超时管理，按预先生成的随机序列执行ops次操作，时间堆和时间轮使用同一个序列：
+    1.adjust(70%)：连接上有数据到达，把超时时间推迟到now + timeout(加一点抖动)；
+    2.add(20%)：连接关闭后新连接复用该槽位，删除旧定时器、添加新定时器；
+    3.tick(10%)：时钟前进TICK个单位(一轮事件循环)，执行所有到期的定时器，到期的连接随后重新添加。
+    时间堆没有调整操作，只能延迟删除旧定时器再添加新定时器，堆中积压的失效定时器到期时才被弹出；
+    时间轮的调整是O(1)的链表摘除和挂入。两者到期的定时器数应当相同，作为结果的校验。
+
+    编译：cmake -S . -B build && cmake --build build --target timer_bench
+    运行：./build/timer_bench [ops] [connections]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "../timer/timer.h"
+#include "../timer/timer_wheel.h"
+
+
+static const int TIMEOUT = 15000;                   //与服务器默认的15000ms请求超时相同，时间单位为1ms
+static const int JITTER = 1000;
+static const int TICK = 10;                         //每次tick时钟前进的单位数，使一部分连接在两次活动之间超时
+
+enum OP_KIND { OP_ADJUST = 0, OP_ADD, OP_TICK, OP_KINDS };
+
+struct op
+{
+    OP_KIND kind;
+    int conn;
+    int jitter;
+};
+
+
+/* 回调中只记录到期的连接，tick之后再重新添加，不在tick过程中修改定时器结构 */
+static std::vector<int> g_expired;
+
+static void heap_expired(heap_client_data * user_data) { g_expired.push_back(user_data->sockfd); }
+static void wheel_expired(client_data * user_data) { g_expired.push_back(user_data->sockfd); }
+
+
+static std::vector<op> make_ops(long count, int connections)
+{
+    std::mt19937 rng(20240517);
+    std::uniform_int_distribution<int> kind(0, 99), conn(0, connections - 1), jitter(0, JITTER);
+    std::vector<op> ops(count);
+    for(op & o : ops)
+    {
+        int k = kind(rng);
+        o.kind = k < 70 ? OP_ADJUST : k < 90 ? OP_ADD : OP_TICK;
+        o.conn = conn(rng);
+        o.jitter = jitter(rng);
+    }
+    return ops;
+}
+
+
+static void report(const char * name, long ops, double ns, long expired, size_t peak)
+{
+    printf("%-8s %8.1f ns/op %8.2f Mops/s  expired %ld  peak size %zu\n", name, ns / ops, ops * 1e3 / ns, expired, peak);
+}
+
+
+static long run_heap(const std::vector<op> & ops, int connections)
+{
+    time_heap heap(connections);
+    std::vector<heap_client_data> users(connections);
+    time_t now = 1;
+    size_t peak = 0;                                //堆中的定时器数，包括已延迟删除的
+    long expired = 0;
+
+    auto arm = [&](int i, int jitter) {
+        heap_timer * timer = new heap_timer;
+        timer->expire = now + TIMEOUT + jitter;
+        timer->cb_func = heap_expired;
+        timer->user_data = &users[i];
+        users[i].timer = timer;
+        heap.add_timer(timer);
+        peak = std::max(peak, (size_t)heap.size());
+    };
+    for(int i = 0; i < connections; i++)
+    {
+        users[i].sockfd = i;
+        arm(i, i % JITTER);
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for(const op & o : ops)
+    {
+        switch(o.kind)
+        {
+            case OP_ADJUST:
+            case OP_ADD:
+            {
+                heap.del_timer(users[o.conn].timer);
+                arm(o.conn, o.jitter);
+                break;
+            }
+            default:
+            {
+                /* 到期的定时器在弹出时释放，延迟删除的定时器也在这时才被弹出 */
+                now += TICK;
+                heap.tick(now);
+                expired += g_expired.size();
+                for(int i : g_expired) arm(i, 0);
+                g_expired.clear();
+                break;
+            }
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    report("heap", ops.size(), std::chrono::duration<double, std::nano>(elapsed).count(), expired, peak);
+    return expired;
+}
+
+
+static long run_wheel(const std::vector<op> & ops, int connections)
+{
+    uint64_t now = 1;
+    timer_wheel * wheel = new timer_wheel(now);
+    std::vector<client_data> users(connections);
+    long expired = 0;
+    size_t peak = 0;
+
+    for(int i = 0; i < connections; i++)
+    {
+        users[i].sockfd = i;
+        users[i].wtimer.cb_func = wheel_expired;
+        users[i].wtimer.user_data = &users[i];
+        users[i].wtimer.expire = now + TIMEOUT + i % JITTER;
+        wheel->add_timer(&users[i].wtimer);
+    }
+    peak = wheel->size();
+
+    auto begin = std::chrono::steady_clock::now();
+    for(const op & o : ops)
+    {
+        wheel_timer & timer = users[o.conn].wtimer;
+        switch(o.kind)
+        {
+            case OP_ADJUST:
+            {
+                wheel->mod_timer(&timer, now + TIMEOUT + o.jitter);
+                break;
+            }
+            case OP_ADD:
+            {
+                wheel->del_timer(&timer);
+                timer.expire = now + TIMEOUT + o.jitter;
+                wheel->add_timer(&timer);
+                break;
+            }
+            default:
+            {
+                now += TICK;
+                wheel->tick(now);
+                expired += g_expired.size();
+                for(int i : g_expired) wheel->mod_timer(&users[i].wtimer, now + TIMEOUT);
+                g_expired.clear();
+                break;
+            }
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    report("wheel", ops.size(), std::chrono::duration<double, std::nano>(elapsed).count(), expired, peak);
+    delete wheel;
+    return expired;
+}
+
+
+int main(int argc, char * argv[])
+{
+    long count = argc > 1 ? atol(argv[1]) : 1000000;
+    int connections = argc > 2 ? atoi(argv[2]) : 10000;
+    if(count <= 0 || connections <= 0)
+    {
+        printf("usage: %s [ops] [connections]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<op> ops = make_ops(count, connections);
+    long kinds[OP_KINDS] = {};
+    for(const op & o : ops) kinds[o.kind]++;
+    printf("%ld ops (%ld adjust, %ld add, %ld tick), %d connections, timeout %d\n",
+           count, kinds[OP_ADJUST], kinds[OP_ADD], kinds[OP_TICK], connections, TIMEOUT);
+
+    long heap_expired = run_heap(ops, connections);
+    long wheel_expired = run_wheel(ops, connections);
+    if(heap_expired != wheel_expired)
+    {
+        fprintf(stderr, "expired timers differ: heap %ld, wheel %ld\n", heap_expired, wheel_expired);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+
+#include "arena.h"
+#include "buffer_pool.h"
+
+
+void * request_arena::do_allocate(size_t bytes, size_t alignment)
+{
+    m_stats.allocations++;
+    m_stats.bytes += bytes;
+
+    uintptr_t p = ((uintptr_t)m_cur + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if(m_cur && p + bytes <= (uintptr_t)m_end)
+    {
+        m_cur = (char *)(p + bytes);
+        return (void *)p;
+    }
+
+    /* 当前块放不下：超大的分配单独malloc，不影响当前块；否则换一个新块，旧块剩余的空间不再使用 */
+    size_t need = sizeof(block) + alignment + bytes;
+    int size;
+    block * b;
+    if(need <= (size_t)buffer_pool::SMALL_SIZE) size = buffer_pool::SMALL_SIZE;
+    else if(need <= (size_t)buffer_pool::LARGE_SIZE) size = buffer_pool::LARGE_SIZE;
+    else size = 0;
+
+    if(size)
+    {
+        b = (block *)buffer_pool::get(size);
+        m_stats.blocks++;
+    }
+    else
+    {
+        b = (block *)malloc(need);
+        m_stats.heap_allocations++;
+    }
+    if(!b) throw std::bad_alloc();
+
+    b->next = m_blocks;
+    b->size = size;
+    m_blocks = b;
+
+    p = ((uintptr_t)(b + 1) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if(size)
+    {
+        m_cur = (char *)(p + bytes);
+        m_end = (char *)b + size;
+    }
+    return (void *)p;
+}
+
+
+void request_arena::reset()
+{
+    while(m_blocks)
+    {
+        block * b = m_blocks;
+        m_blocks = b->next;
+        if(b->size) buffer_pool::put((char *)b, b->size);
+        else free(b);
+    }
+    m_cur = m_end = NULL;
+    m_last = m_stats;
+    m_stats = stats();
+}
@@ -0,0 +1,55 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+/*
+    请求级内存池(bump allocator)：
+    处理请求和组装响应时需要的临时内存都从这里分配，分配只是移动指针，释放是空操作，
+    整批响应发送完毕后一次性reset()，内存块交还buffer_pool。
+    继承std::pmr::memory_resource，可以直接交给std::pmr容器使用：
+        std::pmr::vector<int> v(conn.arena());
+    超过buffer_pool大块的分配才会调用malloc，stats().heap_allocations用来确认热路径上没有malloc。
+*/
+
+#include <stddef.h>
+#include <memory_resource>
+
+
+class request_arena : public std::pmr::memory_resource
+{
+    public:
+        struct stats
+        {
+            size_t allocations;             //分配次数
+            size_t bytes;                   //请求的字节数
+            size_t blocks;                  //从buffer_pool取得的块数
+            size_t heap_allocations;        //超出大块、直接malloc的次数
+        };
+
+        request_arena() : m_blocks(NULL), m_cur(NULL), m_end(NULL), m_stats(), m_last() {}
+        ~request_arena() { reset(); }
+
+        void reset();                                       //释放所有内存块，本轮统计转入last()
+        const stats & current() const { return m_stats; }   //本轮(尚未reset)的统计
+        const stats & last() const { return m_last; }       //上一轮的统计
+
+    private:
+        /* 每个内存块开头的链表节点 */
+        struct block
+        {
+            block * next;
+            int size;                       //buffer_pool的块大小，0表示malloc得到
+        };
+
+        void * do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void *, size_t, size_t) override {}
+        bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override { return this == &other; }
+
+        block * m_blocks;
+        char * m_cur;
+        char * m_end;
+        stats m_stats;
+        stats m_last;
+};
+
+
+#endif
@@ -0,0 +1,110 @@
+#include <stdlib.h>
+
+#include "buffer_pool.h"
+#include "../threadpool/locker.h"
+
+
+/* 空闲块的开头用来存放链表指针 */
+struct free_block
+{
+    free_block * next;
+};
+
+
+struct free_list
+{
+    free_block * head;
+    int count;
+};
+
+
+static const int LOCAL_LIMIT[2] = { 64, 16 };          //每个线程缓存的空闲块上限
+static const int GLOBAL_LIMIT[2] = { 4096, 1024 };     //全局空闲链表上限(各16MB)
+
+static free_list g_free[2];
+static locker g_lock;
+
+
+/* 线程缓存，线程退出时交还全局链表 */
+struct local_cache
+{
+    free_list lists[2];
+
+    ~local_cache()
+    {
+        for(int i = 0; i < 2; i++) flush(i, lists[i].count);
+    }
+
+    /* 把n个块交还全局链表，超出全局上限的直接释放 */
+    void flush(int i, int n)
+    {
+        free_list & local = lists[i];
+        g_lock.lock();
+        while(n-- > 0)
+        {
+            free_block * block = local.head;
+            local.head = block->next;
+            local.count--;
+            if(g_free[i].count < GLOBAL_LIMIT[i])
+            {
+                block->next = g_free[i].head;
+                g_free[i].head = block;
+                g_free[i].count++;
+            }
+            else free(block);
+        }
+        g_lock.unlock();
+    }
+};
+
+static thread_local local_cache t_cache;
+
+
+std::atomic<long> buffer_pool::m_in_use[2];
+
+
+char * buffer_pool::get(int size)
+{
+    int i = index(size);
+    m_in_use[i]++;
+
+    free_list & local = t_cache.lists[i];
+    if(!local.head)
+    {
+        /* 本线程没有空闲块，从全局链表一次取一批 */
+        g_lock.lock();
+        while(g_free[i].head && local.count < LOCAL_LIMIT[i] / 2)
+        {
+            free_block * block = g_free[i].head;
+            g_free[i].head = block->next;
+            g_free[i].count--;
+            block->next = local.head;
+            local.head = block;
+            local.count++;
+        }
+        g_lock.unlock();
+    }
+
+    if(local.head)
+    {
+        free_block * block = local.head;
+        local.head = block->next;
+        local.count--;
+        return (char *)block;
+    }
+    return (char *)aligned_alloc(64, size);
+}
+
+
+void buffer_pool::put(char * buf, int size)
+{
+    int i = index(size);
+    m_in_use[i]--;
+
+    free_list & local = t_cache.lists[i];
+    free_block * block = (free_block *)buf;
+    block->next = local.head;
+    local.head = block;
+    local.count++;
+    if(local.count > LOCAL_LIMIT[i]) t_cache.flush(i, local.count / 2);
+}
@@ -0,0 +1,32 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+/*
+    读缓冲区池：
+    所有连接共享的定长缓冲块，分为4KB和16KB两种规格，请求超出小块时换成大块。
+    1.空闲块先放回本线程的缓存，取用时不加锁；
+    2.线程缓存满时把一半交还全局空闲链表，全局链表超过上限时才真正释放内存；
+    3.连接只在有未处理的数据时持有缓冲块，常驻内存与活跃连接数成正比，而不是与打开的连接数成正比。
+*/
+
+#include <atomic>
+
+
+class buffer_pool
+{
+    public:
+        static const int SMALL_SIZE = 4096;
+        static const int LARGE_SIZE = 16384;
+
+        static char * get(int size);                    //size必须是SMALL_SIZE或LARGE_SIZE
+        static void put(char * buf, int size);
+        static long in_use(int size) { return m_in_use[index(size)]; }     //正在被连接使用的块数
+
+    private:
+        static int index(int size) { return size == SMALL_SIZE ? 0 : 1; }
+
+        static std::atomic<long> m_in_use[2];
+};
+
+
+#endif
@@ -0,0 +1,142 @@
+#include <string.h>
+#include <limits.h>
+#include <sys/socket.h>
+
+#include "output_chain.h"
+#include "buffer_pool.h"
+
+
+/* 一次sendmsg的iovec个数上限，扩展后的iovec数组正好占一个大块 */
+static const int MAX_IOV = IOV_MAX < buffer_pool::LARGE_SIZE / (int)sizeof(struct iovec) ? IOV_MAX : buffer_pool::LARGE_SIZE / (int)sizeof(struct iovec);
+
+
+output_chain::output_chain() : m_iov(m_inline), m_capacity(INLINE_IOV), m_count(0), m_idx(0), m_blocks(NULL), m_cur(NULL), m_end(NULL), m_bytes(0)
+{
+}
+
+
+/* 加入一个片段，与前一个片段在内存中相邻时合并 */
+bool output_chain::push(const char * data, size_t len)
+{
+    if(len == 0) return true;
+    m_bytes += len;
+    if(m_count > m_idx && (char *)m_iov[m_count - 1].iov_base + m_iov[m_count - 1].iov_len == data)
+    {
+        m_iov[m_count - 1].iov_len += len;
+        return true;
+    }
+    if(m_count == m_capacity)
+    {
+        if(m_iov != m_inline) return false;
+        struct iovec * iov = (struct iovec *)buffer_pool::get(buffer_pool::LARGE_SIZE);
+        if(!iov) return false;
+        memcpy(iov, m_inline, sizeof(m_inline));
+        m_iov = iov;
+        m_capacity = buffer_pool::LARGE_SIZE / sizeof(struct iovec);
+    }
+    m_iov[m_count].iov_base = (void *)data;
+    m_iov[m_count].iov_len = len;
+    m_count++;
+    return true;
+}
+
+
+char * output_chain::reserve(size_t len)
+{
+    if(m_cur && m_cur + len <= m_end) return m_cur;
+
+    int size = len + sizeof(block) <= (size_t)buffer_pool::SMALL_SIZE ? buffer_pool::SMALL_SIZE : buffer_pool::LARGE_SIZE;
+    if(len + sizeof(block) > (size_t)size) return NULL;
+    block * b = (block *)buffer_pool::get(size);
+    if(!b) return NULL;
+    b->next = m_blocks;
+    b->size = size;
+    m_blocks = b;
+    m_cur = (char *)(b + 1);
+    m_end = (char *)b + size;
+    return m_cur;
+}
+
+
+bool output_chain::commit(size_t len)
+{
+    if(!push(m_cur, len)) return false;
+    m_cur += len;
+    return true;
+}
+
+
+bool output_chain::append(const void * data, size_t len)
+{
+    const char * p = (const char *)data;
+    while(len > 0)
+    {
+        /* 当前块剩余的空间先用完，不够时再取新块 */
+        size_t n = m_cur ? m_end - m_cur : 0;
+        if(n == 0)
+        {
+            n = len < (size_t)buffer_pool::SMALL_SIZE - sizeof(block) ? len : buffer_pool::SMALL_SIZE - sizeof(block);
+            if(!reserve(n)) return false;
+            n = m_end - m_cur;
+        }
+        if(n > len) n = len;
+        memcpy(m_cur, p, n);
+        if(!commit(n)) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+
+bool output_chain::add_ref(const void * data, size_t len)
+{
+    return push((const char *)data, len);
+}
+
+
+ssize_t output_chain::send(int fd, int flags)
+{
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = m_iov + m_idx;
+    msg.msg_iovlen = m_count - m_idx < MAX_IOV ? m_count - m_idx : MAX_IOV;
+    ssize_t ret = sendmsg(fd, &msg, flags);
+    if(ret > 0) advance(ret);
+    return ret;
+}
+
+
+void output_chain::advance(size_t bytes)
+{
+    while(bytes > 0 && m_idx < m_count)
+    {
+        struct iovec & iv = m_iov[m_idx];
+        if(bytes < iv.iov_len)
+        {
+            iv.iov_base = (char *)iv.iov_base + bytes;
+            iv.iov_len -= bytes;
+            return;
+        }
+        bytes -= iv.iov_len;
+        m_idx++;
+    }
+}
+
+
+void output_chain::clear()
+{
+    while(m_blocks)
+    {
+        block * b = m_blocks;
+        m_blocks = b->next;
+        buffer_pool::put((char *)b, b->size);
+    }
+    if(m_iov != m_inline) buffer_pool::put((char *)m_iov, buffer_pool::LARGE_SIZE);
+    m_iov = m_inline;
+    m_capacity = INLINE_IOV;
+    m_count = 0;
+    m_idx = 0;
+    m_cur = m_end = NULL;
+    m_bytes = 0;
+}
@@ -0,0 +1,60 @@
+#ifndef OUTPUT_CHAIN_H
+#define OUTPUT_CHAIN_H
+
+/*
+    响应输出链：
+    按顺序排列的一组片段，每个片段对应一个iovec，整条链由sendmsg一次发出(每次最多IOV_MAX个)。
+    1.复制的数据(状态行、头部、生成的内容)写入从buffer_pool取得的内存块，同一块内相邻的写入合并为一个片段；
+    2.借用的数据(文件映射、静态字符串)只记录指针，调用者保证发送完毕前有效；
+    3.部分发送时按字节数推进，EAGAIN之后从断点继续；clear()时内存块交还buffer_pool。
+*/
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+
+class output_chain
+{
+    public:
+        static const int INLINE_IOV = 64;                   //片段较少时iovec数组直接放在对象内
+
+        output_chain();
+        ~output_chain() { clear(); }
+
+        bool append(const void * data, size_t len);         //复制数据
+        char * reserve(size_t len);                         //取得len字节的连续空间，写入后调用commit()，len不超过大块
+        bool commit(size_t len);
+        bool add_ref(const void * data, size_t len);        //借用数据，不复制
+
+        int count() const { return m_count; }               //链上的片段数(含已发送的)，clear()后为0
+        bool sent() const { return m_idx == m_count; }      //是否已全部发送
+        size_t bytes() const { return m_bytes; }            //clear()之后加入链的总字节数(含已发送的)
+        int iov(struct iovec ** iv) { *iv = m_iov + m_idx; return m_count - m_idx; }     //还未发送的片段
+        ssize_t send(int fd, int flags);                    //sendmsg发送并推进，返回值与sendmsg相同
+        void advance(size_t bytes);                         //按已发送的字节数推进
+        void clear();
+
+    private:
+        /* 每个内存块开头的链表节点 */
+        struct block
+        {
+            block * next;
+            int size;
+        };
+
+        bool push(const char * data, size_t len);
+
+        struct iovec * m_iov;
+        int m_capacity;
+        int m_count;
+        int m_idx;                                          //第一个还未发送完的片段
+        block * m_blocks;
+        char * m_cur;                                       //当前内存块中未使用的部分
+        char * m_end;
+        size_t m_bytes;
+        struct iovec m_inline[INLINE_IOV];
+};
+
+
+#endif
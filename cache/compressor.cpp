@@ -0,0 +1,118 @@
+#include <string.h>
+#include <zlib.h>
+#include <vector>
+
+#include "compressor.h"
+#include "../http_conn/http_response.h"
+
+
+compressor::compressor(response_cache * cache, int level, int max_pending)
+    : m_cache(cache), m_level(level), m_max_pending(max_pending), m_stop(false), m_compressed(0), m_dropped(0)
+{
+    if(!cache || level < 1 || level > 9 || max_pending <= 0) throw std::exception();
+    if(pthread_create(&m_thread, NULL, worker, this) != 0) throw std::exception();
+}
+
+
+compressor::~compressor()
+{
+    m_lock.lock();
+    m_stop = true;
+    m_ready.signal();
+    m_lock.unlock();
+    pthread_join(m_thread, NULL);
+
+    for(size_t i = 0; i < m_jobs.size(); i++) file_cache::release(m_jobs[i].file);
+}
+
+
+void compressor::submit(const char * key, file_entry * file, std::string_view type)
+{
+    m_lock.lock();
+    if(m_stop || m_pending.count(key))
+    {
+        m_lock.unlock();
+        return;
+    }
+    if(m_jobs.size() >= m_max_pending)
+    {
+        m_lock.unlock();
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_pending.insert(key);
+    m_jobs.push_back(job{ key, file_cache::retain(file), std::string(type) });
+    m_ready.signal();
+    m_lock.unlock();
+}
+
+
+void * compressor::worker(void * arg)
+{
+    compressor * self = (compressor *)arg;
+    self->run();
+    return self;
+}
+
+
+void compressor::run()
+{
+    m_lock.lock();
+    while(true)
+    {
+        while(m_jobs.empty() && !m_stop) m_ready.wait(m_lock.get());
+        if(m_stop) break;
+
+        job j = m_jobs.front();
+        m_jobs.pop_front();
+        m_lock.unlock();
+
+        compress(j);
+        file_cache::release(j.file);
+
+        m_lock.lock();
+        m_pending.erase(j.key);
+    }
+    m_lock.unlock();
+}
+
+
+/* 整个文件一次deflate，windowBits加16输出gzip格式 */
+void compressor::compress(const job & j)
+{
+    const file_entry * file = j.file;
+    size_t size = file->st.st_size;
+    std::vector<char> out(deflateBound(NULL, size) + 32);
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if(deflateInit2(&zs, m_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return;
+    zs.next_in = (Bytef *)file->addr;
+    zs.avail_in = size;
+    zs.next_out = (Bytef *)out.data();
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, Z_FINISH);
+    size_t compressed = zs.total_out;
+    deflateEnd(&zs);
+    if(ret != Z_STREAM_END) return;
+
+    char headers[FILE_HEADERS_LEN];
+    size_t headers_len;
+    if(compressed >= size)
+    {
+        /* 压缩没有收益，在压缩表示的键下缓存原文件 */
+        headers_len = format_file_headers(headers, file->etag, file->last_modified, ENCODING_IDENTITY, true, size, j.type);
+        m_cache->insert(j.key.c_str(), file, std::string_view(headers, headers_len), std::string_view(file->addr, size), file->etag);
+        return;
+    }
+
+    /* 压缩表示的ETag在原文件的ETag后加"-gz" */
+    char etag[ETAG_LEN + 1];
+    size_t etag_len = strlen(file->etag);
+    memcpy(etag, file->etag, etag_len - 1);
+    memcpy(etag + etag_len - 1, "-gz\"", 5);
+
+    headers_len = format_file_headers(headers, etag, file->last_modified, ENCODING_GZIP, true, compressed, j.type);
+    m_cache->insert(j.key.c_str(), file, std::string_view(headers, headers_len), std::string_view(out.data(), compressed), etag);
+    m_compressed.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,65 @@
+#ifndef COMPRESSOR_H
+#define COMPRESSOR_H
+
+/*
+    后台压缩：
+    可压缩的小文件没有预压缩的.gz文件时，请求线程只提交一个任务，本次仍发送原文件；
+    后台线程用zlib压缩一次，把带Content-Encoding的完整响应放入响应缓存("路径\tgzip"为键)，
+    之后的请求直接命中缓存，请求路径上从不压缩。
+    1.同一个键同时只有一个任务，队列满时丢弃新任务，下次请求再提交；
+    2.任务持有文件缓存条目的引用，压缩期间映射不会被释放；
+    3.压缩后没有变小的文件也缓存一个未压缩的记录(只有原文件)，避免反复提交。
+*/
+
+#include <pthread.h>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <unordered_set>
+
+#include "../threadpool/locker.h"
+#include "file_cache.h"
+#include "response_cache.h"
+
+
+class compressor
+{
+    public:
+        /* level为gzip压缩级别(1~9)，max_pending为排队任务上限 */
+        compressor(response_cache * cache, int level, int max_pending = 256);
+        ~compressor();
+
+        /* 提交压缩任务，key为响应缓存中的键，已有同键任务或队列已满时忽略 */
+        void submit(const char * key, file_entry * file, std::string_view type);
+
+        uint64_t compressed() const { return m_compressed.load(std::memory_order_relaxed); }
+        uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    private:
+        struct job
+        {
+            std::string key;
+            file_entry * file;
+            std::string type;
+        };
+
+        static void * worker(void * arg);
+        void run();
+        void compress(const job & j);
+
+    private:
+        response_cache * m_cache;
+        int m_level;
+        size_t m_max_pending;
+        pthread_t m_thread;
+        bool m_stop;
+        locker m_lock;
+        cond m_ready;
+        std::deque<job> m_jobs;
+        std::unordered_set<std::string> m_pending;          //排队或正在压缩的键
+        std::atomic<uint64_t> m_compressed;
+        std::atomic<uint64_t> m_dropped;
+};
+
+
+#endif
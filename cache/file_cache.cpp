@@ -0,0 +1,205 @@
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <functional>
+
+#include "file_cache.h"
+#include "../timer/clock.h"
+#include "../metrics/metrics.h"
+
+
+file_cache::file_cache(int max_entries, int revalidate_interval, off_t mmap_limit) : m_revalidate_interval(revalidate_interval), m_mmap_limit(mmap_limit)
+{
+    if(max_entries <= 0 || revalidate_interval < 0 || mmap_limit < 0) throw std::exception();
+    m_max_entries = (max_entries + SHARD_NUMBER - 1) / SHARD_NUMBER;
+}
+
+
+file_cache::~file_cache()
+{
+    for(int i = 0; i < SHARD_NUMBER; i++)
+    {
+        std::unordered_map<std::string, file_entry *>::iterator it = m_shards[i].entries.begin();
+        for(; it != m_shards[i].entries.end(); ++it) release(it->second);
+    }
+}
+
+
+/* 加载文件：stat，普通且可读的文件再打开，小文件还要建立只读映射。在分片锁之外执行 */
+void file_cache::load(file_entry * entry)
+{
+    if(stat(entry->path.c_str(), &entry->st) < 0)
+    {
+        entry->err = errno;
+        return;
+    }
+    if(!S_ISREG(entry->st.st_mode) || !(entry->st.st_mode & S_IROTH)) return;      //目录和不可读文件只缓存元数据
+    format_http_date(entry->st.st_mtime, entry->last_modified);
+    entry->last_modified[HTTP_DATE_LEN] = '\0';
+    format_etag(entry->st, entry->etag);
+
+    entry->fd = open(entry->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(entry->fd < 0)
+    {
+        entry->err = errno;
+        return;
+    }
+    if(entry->st.st_size > 0 && entry->st.st_size < m_mmap_limit)
+    {
+        void * addr = mmap(0, entry->st.st_size, PROT_READ, MAP_SHARED, entry->fd, 0);
+        if(addr == MAP_FAILED)
+        {
+            entry->err = errno;
+            close(entry->fd);
+            entry->fd = -1;
+            return;
+        }
+        entry->addr = (char *)addr;
+    }
+}
+
+
+bool file_cache::changed(const file_entry * entry, const struct stat & st)
+{
+    return entry->st.st_ino != st.st_ino || entry->st.st_dev != st.st_dev || entry->st.st_size != st.st_size
+        || entry->st.st_mtim.tv_sec != st.st_mtim.tv_sec || entry->st.st_mtim.tv_nsec != st.st_mtim.tv_nsec
+        || entry->st.st_mode != st.st_mode;
+}
+
+
+void file_cache::release(file_entry * entry)
+{
+    if(!entry) return;
+    if(entry->refcount.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    if(entry->addr) munmap(entry->addr, entry->st.st_size);
+    if(entry->fd != -1) close(entry->fd);
+    delete entry;
+}
+
+
+void file_cache::evict(shard & s)
+{
+    while((int)s.entries.size() > m_max_entries)
+    {
+        std::unordered_map<std::string, file_entry *>::iterator victim = s.entries.end();
+        std::unordered_map<std::string, file_entry *>::iterator it = s.entries.begin();
+        for(; it != s.entries.end(); ++it)
+        {
+            file_entry * entry = it->second;
+            if(entry->state == file_entry::LOADING || entry->refcount.load(std::memory_order_acquire) != 1) continue;
+            if(victim == s.entries.end() || entry->last_used < victim->second->last_used) victim = it;
+        }
+        if(victim == s.entries.end()) return;          //所有条目都在使用中，暂时超出上限
+        file_entry * entry = victim->second;
+        s.entries.erase(victim);
+        release(entry);
+    }
+}
+
+
+file_entry * file_cache::acquire(const char * path, int & err)
+{
+    std::string key(path);
+    shard & s = m_shards[std::hash<std::string>()(key) % SHARD_NUMBER];
+    uint64_t now = monotonic_ms();
+    file_entry * stale = NULL;
+
+    s.lock.lock();
+    std::unordered_map<std::string, file_entry *>::iterator it = s.entries.find(key);
+    if(it != s.entries.end())
+    {
+        file_entry * entry = it->second;
+        entry->refcount.fetch_add(1, std::memory_order_relaxed);
+        while(entry->state == file_entry::LOADING) s.loaded.wait(s.lock.get());      //其他线程正在加载，等待结果
+        entry->last_used = now;
+
+        if(now - entry->checked < (uint64_t)m_revalidate_interval)
+        {
+            s.lock.unlock();
+            metrics::add(CNT_FILE_CACHE_HITS);
+            if(entry->state == file_entry::FAILED)
+            {
+                err = entry->err;
+                release(entry);
+                return NULL;
+            }
+            return entry;
+        }
+
+        /* 需要重新校验：先更新校验时间，使其他线程在此期间继续使用旧条目，由本线程在锁外stat */
+        entry->checked = now;
+        s.lock.unlock();
+
+        struct stat st;
+        bool exist = (stat(path, &st) == 0);
+        bool same = (entry->state == file_entry::READY) ? (exist && !changed(entry, st)) : (!exist && errno == entry->err);
+        if(same)
+        {
+            metrics::add(CNT_FILE_CACHE_HITS);
+            if(entry->state == file_entry::FAILED)
+            {
+                err = entry->err;
+                release(entry);
+                return NULL;
+            }
+            return entry;
+        }
+
+        /* 文件已变化，从缓存中摘除旧条目，已持有旧条目的请求不受影响 */
+        s.lock.lock();
+        it = s.entries.find(key);
+        if(it != s.entries.end() && it->second == entry)
+        {
+            s.entries.erase(it);
+            entry->refcount.fetch_sub(1, std::memory_order_relaxed);       //缓存持有的引用，调用者仍持有一个，不会降到0
+        }
+        stale = entry;
+        it = s.entries.find(key);
+        if(it != s.entries.end())
+        {
+            /* 其他线程已经装入了新条目 */
+            file_entry * fresh = it->second;
+            fresh->refcount.fetch_add(1, std::memory_order_relaxed);
+            while(fresh->state == file_entry::LOADING) s.loaded.wait(s.lock.get());
+            s.lock.unlock();
+            release(stale);
+            metrics::add(CNT_FILE_CACHE_HITS);
+            if(fresh->state == file_entry::FAILED)
+            {
+                err = fresh->err;
+                release(fresh);
+                return NULL;
+            }
+            return fresh;
+        }
+    }
+
+    /* 未命中：先插入一个LOADING状态的条目占位，并发请求同一路径的线程会等待它 */
+    file_entry * entry = new file_entry;
+    entry->path = key;
+    entry->refcount.store(2, std::memory_order_relaxed);        //缓存和调用者各一个引用
+    entry->last_used = now;
+    s.entries[key] = entry;
+    evict(s);
+    s.lock.unlock();
+    release(stale);
+    metrics::add(CNT_FILE_CACHE_MISSES);
+
+    load(entry);
+
+    s.lock.lock();
+    entry->checked = now;
+    entry->state = (entry->err == 0) ? file_entry::READY : file_entry::FAILED;
+    s.loaded.broadcast();
+    s.lock.unlock();
+
+    if(entry->state == file_entry::FAILED)
+    {
+        err = entry->err;
+        release(entry);
+        return NULL;
+    }
+    return entry;
+}
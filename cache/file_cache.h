@@ -0,0 +1,88 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+/*
+    打开文件与元数据缓存：
+    以拼接后的文件路径为键，缓存stat结果、打开的fd以及长期存在的只读映射，所有工作线程共享。
+    1.按路径哈希分成多个分片，每个分片一把互斥锁，不同文件之间互不竞争；
+    2.条目带引用计数，并发请求复用同一个映射，最后一个使用者释放时才munmap和close；
+    3.同一路径并发未命中时只有一个线程去加载，其余线程在条件变量上等待加载结果；
+    4.每隔revalidate_interval毫秒重新stat一次，inode、大小或修改时间变化时换成新条目；
+    5.不存在的文件也会缓存(负缓存)，避免404请求反复stat；
+    6.不小于mmap_limit的大文件只缓存fd，由sendfile发送，不建立映射。
+*/
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "../threadpool/locker.h"
+#include "../http_conn/http_response.h"
+
+
+/* 缓存条目 */
+struct file_entry
+{
+    enum STATE
+    {
+        LOADING = 0,            //正在由某个线程加载
+        READY,                  //加载成功
+        FAILED                  //文件不存在或无法打开，err保存错误码
+    };
+
+    std::string path;
+    struct stat st;
+    int fd;                                 //打开的只读fd，非普通文件或不可读时为-1
+    char * addr;                            //只读映射，空文件为NULL
+    int err;
+    STATE state;
+    std::atomic<int> refcount;              //缓存本身持有一个引用
+    uint64_t checked;                       //上一次校验的时间(毫秒)
+    uint64_t last_used;                     //最近一次访问的时间(毫秒)，淘汰时使用
+    char last_modified[32];                 //加载时格式化好的Last-Modified值(HTTP日期)
+    char etag[ETAG_LEN + 1];                //加载时生成的ETag
+
+    file_entry() : fd(-1), addr(NULL), err(0), state(LOADING), refcount(1), checked(0), last_used(0) { last_modified[0] = etag[0] = '\0'; }
+};
+
+
+class file_cache
+{
+    public:
+        /* max_entries为缓存条目上限，revalidate_interval为重新校验间隔(毫秒)，0表示每次都stat，mmap_limit为建立映射的文件大小上限 */
+        file_cache(int max_entries = 1024, int revalidate_interval = 1000, off_t mmap_limit = 64 * 1024);
+        ~file_cache();
+
+        /* 获取文件，成功时返回增加了引用计数的条目，失败时返回NULL并设置err */
+        file_entry * acquire(const char * path, int & err);
+        static void release(file_entry * entry);
+        static file_entry * retain(file_entry * entry) { entry->refcount.fetch_add(1, std::memory_order_relaxed); return entry; }     //增加一个引用
+
+        /* 条目与新的stat结果相比文件是否变化 */
+        static bool changed(const file_entry * entry, const struct stat & st);
+
+    private:
+        static const int SHARD_NUMBER = 16;
+
+        struct shard
+        {
+            locker lock;
+            cond loaded;                    //加载完成时广播
+            std::unordered_map<std::string, file_entry *> entries;
+        };
+
+        void load(file_entry * entry);
+        void evict(shard & s);              //分片超出容量时淘汰最久未使用且没有使用者的条目
+
+    private:
+        int m_max_entries;                  //每个分片的条目上限
+        int m_revalidate_interval;
+        off_t m_mmap_limit;
+        shard m_shards[SHARD_NUMBER];
+};
+
+
+#endif
@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "response_cache.h"
+#include "../timer/clock.h"
+
+
+response_cache::response_cache(size_t budget, size_t max_object, int revalidate_interval)
+    : m_max_object(max_object), m_revalidate_interval(revalidate_interval), m_hits(0), m_misses(0), m_insertions(0), m_evictions(0), m_bytes(0), m_entries(0)
+{
+    if(revalidate_interval < 0) throw std::exception();
+    m_shard_budget = budget / SHARD_NUMBER;
+}
+
+
+response_cache::~response_cache()
+{
+    for(int i = 0; i < SHARD_NUMBER; i++)
+    {
+        for(size_t j = 0; j < m_shards[i].clock.size(); j++) release(m_shards[i].clock[j]);
+    }
+}
+
+
+void response_cache::release(cached_response * entry)
+{
+    if(!entry) return;
+    if(entry->refcount.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    free(entry->data);
+    delete entry;
+}
+
+
+cached_response * response_cache::acquire(const char * path)
+{
+    std::string_view key(path);
+    shard & s = shard_of(key);
+    uint64_t now = monotonic_ms();
+
+    s.lock.lock();
+    std::unordered_map<std::string_view, cached_response *>::iterator it = s.entries.find(key);
+    if(it == s.entries.end() || now - it->second->checked >= (uint64_t)m_revalidate_interval)
+    {
+        s.lock.unlock();
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+    cached_response * entry = it->second;
+    entry->refcount.fetch_add(1, std::memory_order_relaxed);
+    s.lock.unlock();
+
+    if(!entry->referenced.load(std::memory_order_relaxed)) entry->referenced.store(true, std::memory_order_relaxed);
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    return entry;
+}
+
+
+void response_cache::remove(shard & s, cached_response * entry)
+{
+    s.entries.erase(std::string_view(entry->path));
+    std::vector<cached_response *>::iterator it = std::find(s.clock.begin(), s.clock.end(), entry);
+    size_t pos = it - s.clock.begin();
+    *it = s.clock.back();
+    s.clock.pop_back();
+    if(s.hand > pos) s.hand--;
+    if(s.hand >= s.clock.size()) s.hand = 0;
+    s.bytes -= entry->len;
+    m_bytes.fetch_sub(entry->len, std::memory_order_relaxed);
+    m_entries.fetch_sub(1, std::memory_order_relaxed);
+    release(entry);
+}
+
+
+bool response_cache::evict(shard & s, size_t need)
+{
+    while(s.bytes + need > m_shard_budget && !s.clock.empty())
+    {
+        if(s.hand >= s.clock.size()) s.hand = 0;
+        cached_response * entry = s.clock[s.hand];
+        if(entry->referenced.load(std::memory_order_relaxed))
+        {
+            entry->referenced.store(false, std::memory_order_relaxed);
+            s.hand++;
+            continue;
+        }
+        remove(s, entry);
+        m_evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    return s.bytes + need <= m_shard_budget;
+}
+
+
+cached_response * response_cache::revalidate(const char * path, const file_entry * file)
+{
+    std::string_view key(path);
+    shard & s = shard_of(key);
+
+    s.lock.lock();
+    std::unordered_map<std::string_view, cached_response *>::iterator it = s.entries.find(key);
+    if(it == s.entries.end() || file_cache::changed(file, it->second->st))
+    {
+        s.lock.unlock();
+        return NULL;
+    }
+    cached_response * entry = it->second;
+    entry->checked = monotonic_ms();
+    entry->refcount.fetch_add(1, std::memory_order_relaxed);
+    s.lock.unlock();
+    entry->referenced.store(true, std::memory_order_relaxed);
+    return entry;
+}
+
+
+void response_cache::insert(const char * path, const file_entry * file, std::string_view headers)
+{
+    if(!file->addr || (size_t)file->st.st_size > m_max_object) return;
+
+    /* 过期条目对应的文件没有变化，只刷新校验时间 */
+    cached_response * old = revalidate(path, file);
+    if(old)
+    {
+        release(old);
+        return;
+    }
+    insert(path, file, headers, std::string_view(file->addr, file->st.st_size), file->etag);
+}
+
+
+void response_cache::insert(const char * path, const file_entry * file, std::string_view headers, std::string_view body, const char * etag)
+{
+    size_t size = body.size();
+    if(size > m_max_object || headers.size() + size > m_shard_budget) return;
+
+    std::string_view key(path);
+    shard & s = shard_of(key);
+    uint64_t now = monotonic_ms();
+
+    /* 在锁外拼接响应 */
+    cached_response * entry = new cached_response;
+    entry->path = path;
+    entry->st = file->st;
+    memcpy(entry->last_modified, file->last_modified, sizeof(entry->last_modified));
+    strncpy(entry->etag, etag, sizeof(entry->etag) - 1);
+    entry->etag[sizeof(entry->etag) - 1] = '\0';
+    entry->len = headers.size() + size;
+    entry->data = (char *)malloc(entry->len);
+    if(!entry->data)
+    {
+        delete entry;
+        return;
+    }
+    memcpy(entry->data, headers.data(), headers.size());
+    memcpy(entry->data + headers.size(), body.data(), size);
+    entry->checked = now;
+
+    s.lock.lock();
+    std::unordered_map<std::string_view, cached_response *>::iterator it = s.entries.find(key);
+    if(it != s.entries.end()) remove(s, it->second);           //文件已变化的旧条目，或其他线程同时插入的条目，以本次为准
+    if(!evict(s, entry->len))
+    {
+        s.lock.unlock();
+        release(entry);
+        return;
+    }
+    s.entries[std::string_view(entry->path)] = entry;
+    s.clock.push_back(entry);
+    s.bytes += entry->len;
+    m_bytes.fetch_add(entry->len, std::memory_order_relaxed);
+    m_entries.fetch_add(1, std::memory_order_relaxed);
+    s.lock.unlock();
+    m_insertions.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+response_cache::stats response_cache::get_stats() const
+{
+    stats st;
+    st.hits = m_hits.load(std::memory_order_relaxed);
+    st.misses = m_misses.load(std::memory_order_relaxed);
+    st.insertions = m_insertions.load(std::memory_order_relaxed);
+    st.evictions = m_evictions.load(std::memory_order_relaxed);
+    st.bytes = m_bytes.load(std::memory_order_relaxed);
+    st.entries = m_entries.load(std::memory_order_relaxed);
+    return st;
+}
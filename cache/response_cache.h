@@ -0,0 +1,108 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+/*
+    完整响应缓存：
+    小的热点文件把Date之后的全部响应头和文件内容拼成一块连续内存，命中时只需拷贝预组装的状态行和Date，
+    其余部分直接引用这块内存，没有stat、mmap和头部格式化。
+    1.按路径哈希分片，每个分片一把互斥锁，查找用string_view，不分配内存；
+    2.条目带引用计数，正在发送的响应持有引用，淘汰只是从缓存中摘除；
+    3.总内存不超过budget，超出时按CLOCK算法淘汰：命中时置访问位，指针扫过时清零，访问位为0的条目被淘汰；
+    4.条目在revalidate_interval毫秒后过期，过期后的请求走文件缓存(必要时stat)，文件未变化时只刷新校验时间；
+    5.同一文件的压缩表示以"路径\t编码"为键单独缓存，与原文件共用身份校验。
+*/
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "../threadpool/locker.h"
+#include "file_cache.h"
+
+
+/* 缓存的响应 */
+struct cached_response
+{
+    std::string path;
+    struct stat st;                         //构造时文件的stat结果，用来判断文件是否变化
+    char last_modified[32];                 //条件请求比较用，与文件缓存条目中的相同
+    char etag[ETAG_LEN + 1];
+    char * data;                            //Date之后的响应头 + 文件内容
+    size_t len;
+    std::atomic<int> refcount;              //缓存本身持有一个引用
+    std::atomic<bool> referenced;           //CLOCK访问位
+    uint64_t checked;                       //上一次确认文件未变化的时间(毫秒)
+
+    cached_response() : data(NULL), len(0), refcount(1), referenced(false), checked(0) {}
+};
+
+
+class response_cache
+{
+    public:
+        struct stats
+        {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t insertions;
+            uint64_t evictions;
+            uint64_t bytes;                 //缓存中响应占用的字节数
+            uint64_t entries;
+        };
+
+        /* budget为总内存上限，max_object为单个文件的大小上限，revalidate_interval与文件缓存相同 */
+        response_cache(size_t budget, size_t max_object, int revalidate_interval);
+        ~response_cache();
+
+        /* 命中且未过期时返回增加了引用计数的条目，否则返回NULL */
+        cached_response * acquire(const char * path);
+        static void release(cached_response * entry);
+
+        /* 用文件缓存条目和预先格式化的响应头(Date之后的部分)构造缓存条目，文件太大或没有映射时不缓存 */
+        void insert(const char * path, const file_entry * file, std::string_view headers);
+
+        /* 以key缓存由file生成的任意内容(如压缩后的文件)，etag为这一表示的ETag */
+        void insert(const char * key, const file_entry * file, std::string_view headers, std::string_view body, const char * etag);
+
+        /* 过期条目对应的文件没有变化时刷新校验时间，返回增加了引用计数的条目，否则返回NULL */
+        cached_response * revalidate(const char * key, const file_entry * file);
+
+        stats get_stats() const;                        //只读原子计数，不加锁
+
+    private:
+        static const int SHARD_NUMBER = 16;
+
+        struct shard
+        {
+            locker lock;
+            std::unordered_map<std::string_view, cached_response *> entries;     //键指向条目中的path
+            std::vector<cached_response *> clock;                                //CLOCK环
+            size_t hand;
+            size_t bytes;
+
+            shard() : hand(0), bytes(0) {}
+        };
+
+        shard & shard_of(std::string_view path) { return m_shards[std::hash<std::string_view>()(path) % SHARD_NUMBER]; }
+        void remove(shard & s, cached_response * entry);     //从分片中摘除，释放缓存持有的引用
+        bool evict(shard & s, size_t need);                  //淘汰到能放下need字节为止
+
+    private:
+        size_t m_shard_budget;
+        size_t m_max_object;
+        int m_revalidate_interval;
+        shard m_shards[SHARD_NUMBER];
+        std::atomic<uint64_t> m_hits;
+        std::atomic<uint64_t> m_misses;
+        std::atomic<uint64_t> m_insertions;
+        std::atomic<uint64_t> m_evictions;
+        std::atomic<uint64_t> m_bytes;                  //各分片bytes之和，统计时不必逐个加锁
+        std::atomic<uint64_t> m_entries;
+};
+
+
+#endif
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "../buffer/buffer_pool.h"
+
+
+static void usage(const char * prog)
+{
+    printf("usage: %s [-r reactor_number] [-t thread_number] [-s] [-T request_timeout_ms] [-K keepalive_timeout_ms]\n"
+           "       [-C cached_files] [-V revalidate_ms] [-S sendfile_threshold] [-b epoll|uring] [-H header_limit] [-n max_fd] [-M response_cache_bytes] [-Z gzip_level] [-A access_log_dir] [-m metrics_url] ip port\n", prog);
+}
+
+
+bool parse_config(int argc, char * argv[], server_config & config)
+{
+    int opt;
+    while((opt = getopt(argc, argv, "r:t:sT:K:C:V:S:b:H:n:M:Z:A:m:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'r': config.reactor_number = atoi(optarg); break;
+            case 't': config.thread_number = atoi(optarg); break;
+            case 's': config.work_stealing = true; break;
+            case 'T': config.request_timeout = atoi(optarg); break;
+            case 'K': config.keepalive_timeout = atoi(optarg); break;
+            case 'C': config.cached_files = atoi(optarg); break;
+            case 'V': config.revalidate_interval = atoi(optarg); break;
+            case 'S': config.sendfile_threshold = atol(optarg); break;
+            case 'H': config.header_limit = atoi(optarg); break;
+            case 'n': config.max_fd = atoi(optarg); break;
+            case 'M': config.response_cache = atol(optarg); break;
+            case 'Z': config.gzip_level = atoi(optarg); break;
+            case 'A': config.access_log = optarg; break;
+            case 'm': config.metrics_url = optarg; break;
+            case 'b':
+            {
+                if(strcmp(optarg, "uring") == 0) config.uring = true;
+                else if(strcmp(optarg, "epoll") == 0) config.uring = false;
+                else
+                {
+                    usage(argv[0]);
+                    return false;
+                }
+                break;
+            }
+            default:
+            {
+                usage(argv[0]);
+                return false;
+            }
+        }
+    }
+
+    if(argc - optind < 2 || config.reactor_number < 0 || config.thread_number <= 0
+       || config.request_timeout <= 0 || config.keepalive_timeout <= 0
+       || config.cached_files <= 0 || config.revalidate_interval < 0 || config.sendfile_threshold < 0
+       || config.header_limit < 256 || config.header_limit > buffer_pool::LARGE_SIZE || config.max_fd < 0 || config.response_cache < 0
+       || config.gzip_level < 0 || config.gzip_level > 9 || (config.metrics_url && config.metrics_url[0] != '/'))
+    {
+        usage(argv[0]);
+        return false;
+    }
+    config.ip = argv[optind];
+    config.port = atoi(argv[optind + 1]);
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+/*
+    服务器启动参数：
+    用法 ./server [-r reactor_number] [-t thread_number] [-s] [-T request_timeout_ms] [-K keepalive_timeout_ms]
+                 [-C cached_files] [-V revalidate_ms] [-S sendfile_threshold] [-b epoll|uring] [-H header_limit] [-n max_fd] [-M response_cache_bytes] [-Z gzip_level] [-A access_log_dir] [-m metrics_url] ip port
+*/
+
+struct server_config
+{
+    const char * ip;
+    int port;
+    int reactor_number;             //反应堆数量，0表示经典的单反应堆+线程池模式，N>0表示N个one loop per thread反应堆
+    int thread_number;              //线程池中的线程数(仅单反应堆模式使用)
+    bool work_stealing;             //线程池是否使用工作窃取模式
+    int request_timeout;            //连接建立后或收到数据后，完成请求和响应的超时时间(毫秒)
+    int keepalive_timeout;          //长连接响应发送完毕后的空闲超时时间(毫秒)
+    int cached_files;               //打开文件缓存的条目上限
+    int revalidate_interval;        //打开文件缓存重新stat校验的间隔(毫秒)，0表示每次请求都校验
+    long sendfile_threshold;        //不小于该字节数的文件用sendfile发送，更小的文件映射后writev
+    bool uring;                     //使用io_uring后端，每个线程一个循环，数量由reactor_number决定(至少1个)
+    int header_limit;               //请求行加头部的最大字节数，不能超过读缓冲池的大块(16KB)
+    int max_fd;                     //连接表的fd上限，0表示取RLIMIT_NOFILE
+    long response_cache;            //完整响应缓存的内存上限(字节)，0表示不使用
+    int gzip_level;                 //后台压缩的gzip级别(1~9)，0表示只使用预压缩文件，需要启用响应缓存
+    const char * access_log;        //二进制访问日志的目录，NULL表示不记录
+    const char * metrics_url;       //导出Prometheus指标的URL，NULL表示不统计
+
+    server_config() : ip(0), port(0), reactor_number(0), thread_number(8), work_stealing(false),
+                      request_timeout(15000), keepalive_timeout(15000), cached_files(1024), revalidate_interval(1000),
+                      sendfile_threshold(64 * 1024), uring(false), header_limit(8192), max_fd(0),
+                      response_cache(32L * 1024 * 1024), gzip_level(6), access_log(NULL), metrics_url(NULL) {}
+};
+
+/* 解析命令行参数，失败时打印用法并返回false */
+bool parse_config(int argc, char * argv[], server_config & config);
+
+
+#endif
@@ -1,19 +1,28 @@
+#include <sys/sendfile.h>
+
 #include "http_conn.h"
+#include "http_scan.h"
+#include "http_response.h"
+#include "../log/log.h"
+#include "../timer/clock.h"
+
+static_assert(buffer_pool::LARGE_SIZE <= 65535, "header_field offsets are 16-bit");
 
-const char* ok_200_title = "OK";
-const char* error_400_title = "Bad_Request";
 const char* error_400_form = "Your request has bad syntax or is inherently impossible to satisfy.\n";
-const char* error_403_title = "Forbidden";
 const char* error_403_form = "You do not have permission to get file from this server.\n";
-const char* error_404_title = "Not Found";
 const char* error_404_form = "404\n";
-const char* error_500_title = "Internal Error";
 const char* error_500_form = "500\n";
+const char* error_431_form = "The request line and headers are too large.\n";
+const char* error_416_form = "The requested range is not satisfiable.\n";
 
 const char* doc_root = "./";
 
-int http_conn::m_epollfd = -1;
-int http_conn::m_user_count = 0;
+std::atomic<int> http_conn::m_user_count(0);
+file_cache * http_conn::m_file_cache = NULL;
+response_cache * http_conn::m_response_cache = NULL;
+compressor * http_conn::m_compressor = NULL;
+off_t http_conn::m_sendfile_threshold = 64 * 1024;
+int http_conn::m_header_limit = 8192;
 
 
 /* 事件源辅助函数 */
@@ -45,8 +54,10 @@ void removefd(int epollfd, int fd)
 }
 
 
+/* epollfd为-1表示连接由io_uring后端驱动，收发完成后由后端自己决定下一步操作 */
 void modfd(int epollfd, int fd, int ev)
 {
+    if(epollfd == -1) return;
     epoll_event event;
     event.data.fd = fd;
     event.events = ev | EPOLLET | EPOLLONESHOT | EPOLLHUP;
@@ -56,72 +67,211 @@ void modfd(int epollfd, int fd, int ev)
 
 /* 类成员函数 */
 
-void http_conn::init(int socketfd, const sockaddr_in &addr)
+void http_conn::init(int socketfd, const sockaddr_in &addr, int epollfd)
 {
     m_sockfd = socketfd;
     m_address = addr;
-
-    addfd(m_epollfd, socketfd, true);
+    m_epollfd = epollfd;
+    m_file = NULL;
+    m_file_address = 0;
+    m_file_count = 0;
+    m_cached = NULL;
+    m_hit_count = 0;
+    m_accept_at = metrics::enabled() ? monotonic_us() : 0;
+    m_write_begin = 0;
+    m_idle = false;
+
+    if(m_epollfd != -1) addfd(m_epollfd, socketfd, true);      //io_uring后端accept时已设置SOCK_NONBLOCK
     m_user_count++;
+    metrics::add(CNT_ACCEPTED);
     
     init();
 }
 
 
+/* 连接级的初始化：清空读缓冲区和待发送的响应 */
 void http_conn::init()
 {
-    m_check_state = CHECK_STATE_REQUESTLINE;
-    m_method = GET;
-
-    memset(m_read_buf, '\0', READ_BUFFER_SIZE);
-    memset(m_write_buf, '\0', WRITE_BUFFER_SIZE);
-    m_check_idx = 0;
     m_read_idx = 0;
-    m_write_idx = 0;
+    m_check_idx = 0;
     m_start_line = 0;
+    m_request_start = 0;
+    m_deferred = false;
+    m_keep_alive = false;
+
+    m_out.clear();
+    m_responses = 0;
+    m_sendfile = false;
+    m_sendfile_entry = NULL;
+    m_file_offset = 0;
+    m_file_end = 0;
+    m_slices = NULL;
+    m_slice_count = 0;
+    m_slice_next = 0;
+    m_arena.reset();
+
+    init_request();
+}
+
+
+/* 请求级的初始化：只重置解析状态，读缓冲区中后续流水线请求的数据保持不动 */
+void http_conn::init_request()
+{
+    m_check_state = CHECK_STATE_REQUESTLINE;
+    m_method = GET;
 
     m_url = 0;
-    m_host = 0;
     m_version = 0;
+    m_line_end = 0;
     m_linger = false;
     m_content_length = 0;
-    memset(m_real_file, '\0', FILENAME_LEN);
+    m_body_left = 0;
+    m_header_count = 0;
+    m_request_begin = 0;
+    memset(m_known, -1, sizeof(m_known));
 }
 
 
+/*
+    fd号在close之后可能立即被其他reactor accept并重新初始化同一个槽位，所以先释放槽位，最后才close。
+    工作线程和定时器可能同时关闭同一个连接，用原子交换保证只有一方执行关闭。
+    槽位本身不会释放，超时或出错时读缓冲区中可能还有不完整的请求，这里把读缓冲块、输出链和请求级内存都交还缓冲池，
+    关闭的连接不占用池中的内存。
+*/
 void http_conn::close_conn(bool real_close)
 {
-    if(real_close && m_sockfd != -1)
+    if(!real_close) return;
+    int sockfd = __atomic_exchange_n(&m_sockfd, -1, __ATOMIC_ACQ_REL);
+    if(sockfd == -1) return;
+
+    m_user_count--;
+    metrics::add(CNT_CLOSED);
+    set_idle(false);
+    unmap();
+    m_out.clear();
+    m_arena.reset();
+    if(m_read_buf) buffer_pool::put(m_read_buf, m_read_size);
+    m_read_buf = NULL;
+    m_read_size = 0;
+    m_read_idx = 0;
+    m_check_idx = 0;
+    if(m_epollfd != -1) removefd(m_epollfd, sockfd);          //io_uring后端由调用者异步关闭fd
+}
+
+
+/*
+    解析读缓冲区中所有完整的请求(HTTP/1.1流水线)，响应按请求顺序排入同一批iovec，由一次writev发出。
+    一批响应的数量、写缓冲区剩余空间有限，sendfile响应只能是一批中的最后一个，
+    超出时剩下的请求留在读缓冲区，这一批发送完毕后再处理(pending_input())。
+*/
+bool http_conn::process()
+{
+    m_deferred = false;
+    while(true)
     {
-        removefd(m_epollfd, m_sockfd);
-        m_sockfd = -1;
-        m_user_count--;
+        if(m_responses == MAX_PIPELINE || m_sendfile)
+        {
+            m_deferred = m_read_idx > m_request_start;
+            break;
+        }
+
+        HTTP_CODE read_ret = process_read();
+        if(read_ret == NO_REQUEST) break;
+        if(read_ret == BAD_REQUEST || read_ret == INTERVAL_ERROR || read_ret == HEADER_TOO_LARGE) m_linger = false;     //请求边界已不可信，响应后关闭连接
+
+        size_t out_before = m_out.bytes();
+        if(!process_write(read_ret))
+        {
+            close_conn();
+            return false;
+        }
+        if(access_log::enabled()) log_access(out_before);
+        m_responses++;
+        m_keep_alive = m_linger;
+
+        m_start_line = m_check_idx;
+        m_request_start = m_check_idx;
+        init_request();
+        if(!m_keep_alive) break;            //短连接之后的数据不再处理
     }
+    compact();
+    release_read();
+
+    if(m_out.count() > 0 && !m_write_begin && metrics::enabled()) m_write_begin = monotonic_us();
+    if(m_out.count() == 0)
+    {
+        modfd(m_epollfd, m_sockfd, EPOLLIN);
+        return true;
+    }
+    modfd(m_epollfd, m_sockfd, EPOLLOUT);
+    return true;
 }
 
 
-void http_conn::process()
+/* 已处理的请求从读缓冲区前部移除，未完整的请求移到缓冲区开头，已解析出的指针随之平移 */
+void http_conn::compact()
 {
-    HTTP_CODE read_ret = process_read();
-    if(read_ret == NO_REQUEST)
+    int delta = m_request_start;
+    if(delta == 0) return;
+
+    if(m_read_idx > delta) memmove(m_read_buf, m_read_buf + delta, m_read_idx - delta);
+    m_read_idx -= delta;
+    m_check_idx -= delta;
+    m_start_line -= delta;
+    m_request_start = 0;
+    if(m_line_end) m_line_end -= delta;
+    if(m_url) m_url -= delta;
+    if(m_version) m_version -= delta;
+}
+
+
+/* 首次读入时从缓冲池取小块；占满时先压缩，仍然占满(一个请求超过小块)时换成大块，已解析出的指针随之平移 */
+bool http_conn::reserve_read()
+{
+    if(!m_read_buf)
     {
-        modfd(m_epollfd, m_sockfd, EPOLLIN);
-        return;
+        m_read_buf = buffer_pool::get(buffer_pool::SMALL_SIZE);
+        if(!m_read_buf) return false;
+        m_read_size = buffer_pool::SMALL_SIZE;
     }
+    if(m_read_idx < m_read_size) return true;
+
+    compact();
+    if(m_read_idx < m_read_size) return true;
+    if(m_read_size == buffer_pool::LARGE_SIZE) return false;
+
+    char * buf = buffer_pool::get(buffer_pool::LARGE_SIZE);
+    if(!buf) return false;
+    memcpy(buf, m_read_buf, m_read_idx);
+    if(m_line_end) m_line_end = buf + (m_line_end - m_read_buf);
+    if(m_url) m_url = buf + (m_url - m_read_buf);
+    if(m_version) m_version = buf + (m_version - m_read_buf);
+    buffer_pool::put(m_read_buf, m_read_size);
+    m_read_buf = buf;
+    m_read_size = buffer_pool::LARGE_SIZE;
+    return true;
+}
 
-    bool write_ret = process_write(read_ret);
-    if(!write_ret) close_conn();
-    modfd(m_epollfd, m_sockfd, EPOLLOUT);
+
+/* 长连接空闲时不占用缓冲区 */
+void http_conn::release_read()
+{
+    if(!m_read_buf || m_read_idx != 0) return;
+    buffer_pool::put(m_read_buf, m_read_size);
+    m_read_buf = NULL;
+    m_read_size = 0;
 }
 
 
+/* 缓冲区占满时停止读取，剩下的数据留在socket中，process()之后重新注册的EPOLLIN会再次触发 */
 bool http_conn::read()
 {
-    if(m_read_idx > READ_BUFFER_SIZE) return false;
     int bytes_read = 0;
+    bool arrived = false;                   //reserve_read()可能压缩缓冲区，不能用m_read_idx的变化判断
     while(true)
     {
-        bytes_read = recv(m_sockfd, m_read_buf + m_read_idx, READ_BUFFER_SIZE, 0);
+        if(!reserve_read()) break;
+        bytes_read = recv(m_sockfd, m_read_buf + m_read_idx, m_read_size - m_read_idx, 0);
         if(bytes_read == -1)
         {
             if(errno == EAGAIN || errno == EWOULDBLOCK) break;
@@ -130,57 +280,148 @@ bool http_conn::read()
         else if(bytes_read == 0) return false;
 
         m_read_idx += bytes_read;
+        arrived = true;
     }
-    return true;
+    if(arrived) input_arrived();
+    return m_read_buf != NULL;
 }
 
 
+/*
+    一次sendmsg发送整批响应(最多IOV_MAX个片段)，部分发送时输出链按已发送的字节数推进，EAGAIN后从断点继续。
+    最后一个响应使用sendfile时，头部带MSG_MORE发送，使其与随后sendfile的第一段数据合并成满包。
+*/
 bool http_conn::write()
 {
-    int temp = 0;
-    int bytes_have_send = 0;
-    int bytes_to_send = m_write_idx;
-    
-    if(bytes_to_send == 0)
+    if(m_out.count() == 0)
     {
         modfd(m_epollfd, m_sockfd, EPOLLIN);
-        init();
         return true;
     }
 
     while(true)
     {
-        temp = writev(m_sockfd, m_iv, m_iv_count);
-        if(temp <= -1)
+        while(!m_out.sent())
         {
-            if(errno == EAGAIN)
+            ssize_t temp = m_out.send(m_sockfd, m_sendfile && m_file_offset < m_file_end ? MSG_MORE : 0);
+            if(temp <= -1)
             {
-                modfd(m_epollfd, m_sockfd, EPOLLOUT);
-                return true;
+                if(errno == EAGAIN)
+                {
+                    modfd(m_epollfd, m_sockfd, EPOLLOUT);
+                    return true;
+                }
+                unmap();
+                return false;
             }
-            unmap();
-            return false;
         }
 
-        bytes_to_send -= temp;
-        bytes_have_send += temp;
-
-        if(bytes_have_send >= bytes_to_send)
+        /* 文件偏移保存在m_file_offset中，EAGAIN后从断点继续 */
+        while(m_sendfile && m_file_offset < m_file_end)
         {
-            unmap();
-            if(m_linger)
+            ssize_t temp = sendfile(m_sockfd, m_sendfile_entry->fd, &m_file_offset, m_file_end - m_file_offset);
+            if(temp <= -1)
             {
-                init();
-                modfd(m_epollfd, m_sockfd, EPOLLIN);
-                return true;
+                if(errno == EAGAIN)
+                {
+                    modfd(m_epollfd, m_sockfd, EPOLLOUT);
+                    return true;
+                }
+                unmap();
+                return false;
             }
-            else
+            if(temp == 0)                   //文件被截断，无法发送完声明的长度
             {
-                modfd(m_epollfd, m_sockfd, EPOLLIN);
+                unmap();
                 return false;
             }
         }
+
+        /* multipart/byteranges的下一段：段头部接在输出链末尾，文件偏移移到下一个区间 */
+        if(m_slice_next == m_slice_count) break;
+        const file_slice & s = m_slices[m_slice_next++];
+        if(!m_out.add_ref(s.header, s.header_len))
+        {
+            unmap();
+            return false;
+        }
+        m_file_offset = s.first;
+        m_file_end = s.end;
+    }
+    return finish_write();
+}
+
+
+/* io_uring后端收到数据后调用，与read()一样把数据追加到读缓冲区 */
+int http_conn::read(const char * data, int len)
+{
+    int copied = 0;
+    while(copied < len && reserve_read())
+    {
+        int n = std::min(len - copied, m_read_size - m_read_idx);
+        memcpy(m_read_buf + m_read_idx, data + copied, n);
+        m_read_idx += n;
+        copied += n;
     }
+    if(copied) input_arrived();
+    return copied;
+}
+
+
+int http_conn::response_iov(struct iovec ** iv)
+{
+    if(m_sendfile) return 0;
+    return m_out.iov(iv);
+}
+
+
+/* 整批响应发送完毕：释放文件引用、清空输出链，解析状态在每个请求处理完时已经重置 */
+bool http_conn::finish_write()
+{
+    unmap();
+    m_out.clear();
+    m_responses = 0;
+    m_sendfile = false;
+    m_sendfile_entry = NULL;
+    m_file_offset = 0;
+    m_file_end = 0;
+    m_slices = NULL;
+    m_slice_count = 0;
+    m_slice_next = 0;
+    m_arena.reset();                    //这一批响应不再引用请求级内存
+
+    if(m_write_begin)
+    {
+        metrics::record(STAGE_WRITE, monotonic_us() - m_write_begin);
+        m_write_begin = 0;
+    }
+    metrics::add(CNT_ARENA_BYTES, m_arena.last().bytes);
+    metrics::add(CNT_ARENA_HEAP_ALLOCATIONS, m_arena.last().heap_allocations);
+    set_idle(m_keep_alive && !m_deferred);
+
+    /* 还有留到下一批的请求时由调用者再次派发，此时注册EPOLLIN会让新数据触发另一次派发，两个线程同时处理同一连接 */
+    if(!m_deferred) modfd(m_epollfd, m_sockfd, EPOLLIN);
+    return m_keep_alive;
+}
+
+
+void http_conn::input_arrived()
+{
+    set_idle(false);
+    if(m_accept_at)
+    {
+        metrics::record(STAGE_ACCEPT_READ, monotonic_us() - m_accept_at);
+        m_accept_at = 0;
+    }
+}
+
+
+/* 同一时刻只有持有该连接的线程调用，计数记在调用线程的分片上 */
+void http_conn::set_idle(bool idle)
+{
+    if(m_idle == idle) return;
+    m_idle = idle;
+    metrics::gauge_add(GAUGE_IDLE_CONNECTIONS, idle ? 1 : -1);
 }
 
 
@@ -190,18 +431,19 @@ http_conn::HTTP_CODE http_conn::process_read()
     HTTP_CODE ret = NO_REQUEST;
     LINE_STATUS  line_status = LINE_OK;
     char * text = 0;
+    uint64_t parse_begin = metrics::enabled() ? monotonic_us() : 0;
 
     while((m_check_state == CHECK_STATE_CONTENT && line_status == LINE_OK) || ((line_status = parse_line()) == LINE_OK))
     {
+        if(m_check_state != CHECK_STATE_CONTENT && m_check_idx - m_request_start > m_header_limit) return HEADER_TOO_LARGE;
         text = get_line();
         m_start_line = m_check_idx;
-        printf("got 1 http line: %s\n", text);
+        LOG_DEBUG("got 1 http line: %s", text);
 
         switch(m_check_state)
         {
             case CHECK_STATE_REQUESTLINE:
             {
-                printf("解析请求行： ");
                 ret = parse_request_line(text);
                 
                 if(ret == BAD_REQUEST) return BAD_REQUEST;
@@ -210,11 +452,10 @@ http_conn::HTTP_CODE http_conn::process_read()
 
             case CHECK_STATE_HEADER:
             {
-                printf("解析请求头： ");
                 ret = parse_headers(text);
 
                 if(ret == BAD_REQUEST) return BAD_REQUEST;
-                else if(ret == GET_REQUEST) return do_request();
+                else if(ret == GET_REQUEST) return timed_request(parse_begin);
                 break;
             }
 
@@ -222,7 +463,7 @@ http_conn::HTTP_CODE http_conn::process_read()
             {
                 ret = parse_content(text);
                 
-                if(ret == GET_REQUEST) return do_request();
+                if(ret == GET_REQUEST) return timed_request(parse_begin);
                 line_status = LINE_OPEN;
                 break;
             }
@@ -234,108 +475,197 @@ http_conn::HTTP_CODE http_conn::process_read()
         }
     }
 
+    /* 请求行和头部还不完整，但已达到上限，不再等待 */
+    if(m_check_state != CHECK_STATE_CONTENT && m_read_idx - m_request_start >= m_header_limit) return HEADER_TOO_LARGE;
     return NO_REQUEST;
 }
 
+/* 把当前请求的响应追加到这一批响应之后 */
 bool http_conn::process_write(HTTP_CODE ret)
 {
     switch(ret)
     {
         case INTERVAL_ERROR:
         {
-            add_status_line(500, error_500_title);
-            add_headers(strlen(error_500_form));
-            if(!add_content(error_500_form)) return false;
+            if(!add_error(500, error_500_form)) return false;
+            break;
+        }
+        case HEADER_TOO_LARGE:
+        {
+            if(!add_error(431, error_431_form)) return false;
             break;
         }
         case BAD_REQUEST:
         {
-            add_status_line(400, error_400_title);
-            add_headers(strlen(error_400_form));
-            if(!add_content(error_400_form)) return false;
+            if(!add_error(400, error_400_form)) return false;
             break;
         }
         case NO_RESOURCE:
         {
-            add_status_line(404, error_404_title);
-            add_headers(strlen(error_404_form));
-            if(!add_content(error_404_form)) return false;
+            if(!add_error(404, error_404_form)) return false;
             break;
         }
         case FORBIDDEN_REQUEST:
         {
-            add_status_line(403, error_403_title);
-            add_headers(strlen(error_403_form));
-            if(!add_content(error_403_form)) return false;
+            if(!add_error(403, error_403_form)) return false;
+            break;
+        }
+        case METRICS_REQUEST:
+        {
+            /* 指标文本先生成到线程本地的字符串，再复制到请求级内存池，随这一批响应一起释放 */
+            static thread_local std::string text;
+            text.clear();
+            metrics::render(text);
+            char * body = (char *)m_arena.allocate(text.size(), 1);
+            memcpy(body, text.data(), text.size());
+            if(!add_status_line(200) || !add_header("Cache-Control", "no-store")) return false;
+            if(!add_headers(text.size(), "text/plain; version=0.0.4; charset=utf-8")) return false;
+            return m_out.add_ref(body, text.size());
+        }
+        case CACHED_REQUEST:
+        {
+            /* 状态行和Date之后的部分直接引用缓存中预先拼好的响应，条目由这一批响应持有 */
+            if(!add_status_line(200)) return false;
+            cached_response * hit = m_cached;
+            m_cached = NULL;
+            m_hits[m_hit_count++] = hit;
+            return m_out.add_ref(hit->data, hit->len);
+        }
+        case NOT_MODIFIED:
+        {
+            /* 只有头部的304，验证器来自命中的响应缓存条目或文件缓存条目 */
+            bool ok;
+            if(m_cached)
+            {
+                ok = add_status_line(304) && add_header("ETag", m_cached->etag) && add_header("Last-Modified", m_cached->last_modified);
+                response_cache::release(m_cached);
+                m_cached = NULL;
+            }
+            else
+            {
+                ok = add_status_line(304) && add_header("ETag", m_file->etag) && add_header("Last-Modified", m_file->last_modified);
+                file_cache::release(m_file);
+                m_file = NULL;
+            }
+            if(!ok || (m_vary && !add_header("Vary", "Accept-Encoding")) || !add_content("\r\n")) return false;
+            break;
+        }
+        case RANGE_REQUEST:
+        {
+            if(!add_status_line(206) || !add_header("ETag", m_file->etag) || !add_header("Last-Modified", m_file->last_modified)) return false;
+            if(m_vary && !add_header("Vary", "Accept-Encoding")) return false;
+            if(!add_ranges(content_type(m_real_file))) return false;
+            break;
+        }
+        case RANGE_NOT_SATISFIABLE:
+        {
+            char range[8 + 20];
+            memcpy(range, "bytes */", 8);
+            char * end = format_uint(range + 8, m_file_stat.st_size);
+            bool ok = add_status_line(416) && add_header("Content-Range", std::string_view(range, end - range));
+            file_cache::release(m_file);
+            m_file = NULL;
+            if(!ok || !add_headers(strlen(error_416_form), "text/plain; charset=utf-8") || !add_content(error_416_form)) return false;
             break;
         }
         case FILE_REQUEST:
         {
-            add_status_line(200, ok_200_title);
+            if(!add_status_line(200)) return false;
             if(m_file_stat.st_size != 0)
             {
-                add_headers(m_file_stat.st_size);
-                m_iv[0].iov_base = m_write_buf;
-                m_iv[0].iov_len = m_write_idx;
-                m_iv[1].iov_base = m_file_address;
-                m_iv[1].iov_len = m_file_stat.st_size;
-                m_iv_count = 2;
-                return true;
+                char * headers = m_out.reserve(FILE_HEADERS_LEN);
+                if(!headers) return false;
+                size_t headers_len = format_file_headers(headers, m_file->etag, m_file->last_modified, m_encoding, m_vary,
+                                                         m_file_stat.st_size, content_type(m_real_file));
+                if(!m_out.commit(headers_len)) return false;
+
+                /* 映射发送的小文件连同响应头放入响应缓存，之后的请求不再经过文件缓存，预压缩文件以压缩表示的键缓存 */
+                if(m_response_cache && m_file_address && m_file_stat.st_size < m_sendfile_threshold)
+                {
+                    m_response_cache->insert(m_encoding ? m_cache_key : m_real_file, m_file, std::string_view(headers, headers_len));
+                }
+
+                /* 文件引用由这一批响应持有，发送完毕后统一释放 */
+                file_entry * file = m_file;
+                m_file = NULL;
+                m_files[m_file_count++] = file;
+
+                /* 大文件(或缓存中没有映射的文件)不经过用户态内存，由sendfile直接从页缓存发送 */
+                if(m_file_stat.st_size >= m_sendfile_threshold || !m_file_address)
+                {
+                    m_sendfile = true;
+                    m_sendfile_entry = file;
+                    m_file_offset = 0;
+                    m_file_end = m_file_stat.st_size;
+                    return true;
+                }
+                return m_out.add_ref(m_file_address, m_file_stat.st_size);
             }
             else
             {
+                bool ok = add_header("ETag", m_file->etag) && add_header("Last-Modified", m_file->last_modified);
+                file_cache::release(m_file);
+                m_file = NULL;
                 const char* ok_string = "<html><body></body></html>";
-                add_headers(strlen(ok_string));
-                if(!add_content(ok_string)) return false;
+                if(!ok || !add_headers(strlen(ok_string), "text/html; charset=utf-8") || !add_content(ok_string)) return false;
+                break;
             }
         }
         default:
             return false;
     }
-    m_iv[0].iov_base = m_write_buf;
-    m_iv[0].iov_len = m_write_idx;
-    m_iv_count = 1;
     return true;
 }
 
-/* 从状态机：处理头部每行信息 */
+/* 从状态机：处理头部每行信息，行结束符由向量化扫描查找，没找到时m_check_idx停在数据末尾，下次从这里继续 */
 http_conn::LINE_STATUS http_conn::parse_line()
 {
-    char temp;
-    for(; m_check_idx < m_read_idx; m_check_idx++)
+    m_check_idx = scan_eol(m_read_buf + m_check_idx, m_read_buf + m_read_idx) - m_read_buf;
+    if(m_check_idx == m_read_idx) return LINE_OPEN;
+
+    char temp = m_read_buf[m_check_idx];
+    if(temp == '\r')
     {
-        temp = m_read_buf[m_check_idx];
-        if(temp == '\r')
+        if(m_check_idx + 1 == m_read_idx) return LINE_OPEN;         //达到头部数据末尾
+        else if(m_read_buf[m_check_idx + 1] == '\n')                //遇到\r\n行结尾
         {
-            if(m_check_idx + 1 == m_read_idx) return LINE_OPEN;         //达到头部数据末尾
-            else if(m_read_buf[m_check_idx + 1] == '\n')                //遇到\r\n行结尾
-            {
-                m_read_buf[m_check_idx++] = '\0';
-                m_read_buf[m_check_idx++] = '\0';
-                return LINE_OK;
-            }
-            return LINE_BAD;
+            m_line_end = m_read_buf + m_check_idx;
+            m_read_buf[m_check_idx++] = '\0';
+            m_read_buf[m_check_idx++] = '\0';
+            return LINE_OK;
         }
-        else if(temp == '\n')
+        return LINE_BAD;
+    }
+    else
+    {
+        if(m_check_idx > 1 && m_read_buf[m_check_idx - 1] == '\r')
         {
-            if(m_check_idx > 1 && m_read_buf[m_check_idx - 1] == '\r')
-            {
-                m_read_buf[m_check_idx-1] = '\0';
-                m_read_buf[m_check_idx++] = '\0';
-                return LINE_OK;
-            }
-            return LINE_BAD;
+            m_line_end = m_read_buf + m_check_idx - 1;
+            m_read_buf[m_check_idx-1] = '\0';
+            m_read_buf[m_check_idx++] = '\0';
+            return LINE_OK;
         }
+        return LINE_BAD;
     }
+}
+
 
-    return LINE_OPEN;
+/* 跳过空格和制表符 */
+static char * skip_blank(char * p, const char * end)
+{
+    while(p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
 }
 
 
 http_conn::HTTP_CODE http_conn::parse_request_line(char * text)
 {
-    m_url = strpbrk(text, " \t");           //在text中查找" \t"，返回第一个匹配的字符及其后面的字符串
-    if(!m_url) return BAD_REQUEST;
+    if(access_log::enabled()) m_request_begin = monotonic_us();
+
+    /* 方法、URL和版本之间以空格或制表符分隔，每个分隔符都只扫描一遍 */
+    char * end = m_line_end;
+    m_url = (char *)scan_any2(text, end, ' ', '\t');
+    if(m_url == end) return BAD_REQUEST;
 
     *m_url++ = '\0';                        //清除url中的 \t
 
@@ -343,12 +673,12 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char * text)
     if(strcasecmp(method, "GET") == 0) m_method = GET;          //忽略大小写比较method和“GET”，若相同则返回0。
     else return BAD_REQUEST;
 
-    m_url += strspn(m_url, " \t");                          //返回在m_url中第一个不在字符串" \t"中出现的字符下标
-    m_version = strpbrk(m_url, " \t");
-    if(!m_version) return BAD_REQUEST;
+    m_url = skip_blank(m_url, end);
+    m_version = (char *)scan_any2(m_url, end, ' ', '\t');
+    if(m_version == end) return BAD_REQUEST;
 
     *m_version++ = '\0';
-    m_version += strspn(m_version, " \t");
+    m_version = skip_blank(m_version, end);
     if(strcasecmp(m_version, "HTTP/1.1") != 0) return BAD_REQUEST;
 
     if(strncasecmp(m_url, "http//", 7) == 0)
@@ -371,35 +701,48 @@ http_conn::HTTP_CODE http_conn::parse_headers(char* text)
         if(m_content_length != 0)           //如果HTTP请求有消息体，则还需要读取m_content_length字节的消息体，状态机转移到CHECK_STATE_CONTENT状态
         {
             m_check_state = CHECK_STATE_CONTENT;
+            m_body_left = m_content_length;
             return NO_REQUEST;             
         }
         return GET_REQUEST;                 //否则说明已经得到了一个完整的HTTP请求
     }
 
-    else if(strncasecmp(text, "Connection:", 11) == 0)
-    {
-        text += 11;
-        text += strspn(text, " \t");
-        if(strcasecmp(text, "keep-alive") == 0) m_linger = true;
-    }
-
-    else if(strncasecmp(text, "Content-Length:", 15) == 0)
+    /* 一次扫描找到冒号，名称和去掉首尾空白的值以(偏移, 长度)记入头部表 */
+    char * end = m_line_end;
+    char * colon = (char *)scan_any2(text, end, ':', ':');
+    if(colon == end || colon == text) return BAD_REQUEST;
+    if(m_header_count == MAX_HEADERS) return BAD_REQUEST;
+
+    char * value = skip_blank(colon + 1, end);
+    while(end > value && (end[-1] == ' ' || end[-1] == '\t')) end--;
+
+    const char * base = m_read_buf + m_request_start;
+    header_field & h = m_headers[m_header_count];
+    h.name_off = text - base;
+    h.name_len = colon - text;
+    h.value_off = value - base;
+    h.value_len = end - value;
+    h.id = header_lookup(text, h.name_len);
+    if(h.id != HDR_UNKNOWN && m_known[h.id] < 0) m_known[h.id] = m_header_count;
+    m_header_count++;
+
+    switch(h.id)
     {
-        text += 15;
-        text += strspn(text, " \t");
-        m_content_length = atol(text);
-    }
-
-    else if(strncasecmp(text+2, "Host:", 5) == 0)
-    {
-        text += 5;
-        text += strspn(text, " \t");
-        m_host = text;
-        // sleep(5);
-    }
-    else
-    {
-        printf("oop! unknow header %s\n", text);
+        case HDR_CONNECTION:
+        {
+            if(h.value_len == 10 && strncasecmp(value, "keep-alive", 10) == 0) m_linger = true;
+            break;
+        }
+        case HDR_CONTENT_LENGTH:
+        {
+            char * digits_end;
+            long length = strtol(value, &digits_end, 10);
+            if(digits_end == value || length < 0 || length > INT_MAX) return BAD_REQUEST;
+            m_content_length = (int)length;
+            break;
+        }
+        default:
+            break;
     }
     return NO_REQUEST;
 }
@@ -407,91 +750,361 @@ http_conn::HTTP_CODE http_conn::parse_headers(char* text)
 
 http_conn::HTTP_CODE http_conn::parse_content(char* text)
 {
-    if(m_read_idx >= (m_content_length + m_check_idx))
+    /*
+        没有处理程序读取消息体，已到达的部分直接丢弃，消息体再大也不占用读缓冲区。
+        消息体之后可能紧跟着下一个流水线请求，不能在消息体末尾写'\0'
+    */
+    int available = m_read_idx - m_check_idx;
+    if(available >= m_body_left)
     {
-        text[m_content_length] = '\0';
+        m_check_idx += m_body_left;
+        m_body_left = 0;
         return GET_REQUEST;
     }
+    m_body_left -= available;
+    m_read_idx = m_check_idx;
     return NO_REQUEST;
 }
 
 
+/* 请求完整时调用，parse_begin为这一次process_read()开始的时间，0表示不统计 */
+http_conn::HTTP_CODE http_conn::timed_request(uint64_t parse_begin)
+{
+    if(!parse_begin) return do_request();
+    uint64_t now = monotonic_us();
+    metrics::record(STAGE_PARSE, now - parse_begin);
+    HTTP_CODE ret = do_request();
+    metrics::record(STAGE_REQUEST, monotonic_us() - now);
+    return ret;
+}
+
+
 http_conn::HTTP_CODE http_conn::do_request()
 {
+    if(metrics::match(m_url)) return METRICS_REQUEST;        //指标地址优先于同名文件
+
     strcpy(m_real_file, doc_root);
     int len  = strlen(doc_root);
     
     strncpy(m_real_file + len, m_url, FILENAME_LEN - len - 1);
-    printf("文件名： %s\n", m_real_file);
-    if(stat(m_real_file, &m_file_stat) < 0) return NO_RESOURCE;
-    if(!(m_file_stat.st_mode & S_IROTH)) return FORBIDDEN_REQUEST;
-    if(S_ISDIR(m_file_stat.st_mode)) return BAD_REQUEST;
+    m_real_file[FILENAME_LEN - 1] = '\0';
+    LOG_DEBUG("文件名： %s", m_real_file);
+
+    /* 可压缩的类型按Accept-Encoding协商，Range请求只按原文件响应 */
+    std::string_view type = content_type(m_real_file);
+    m_encoding = ENCODING_IDENTITY;
+    m_vary = compressible(type);
+    int accepted = 0;
+    if(m_vary && !has_header(HDR_RANGE) && has_header(HDR_ACCEPT_ENCODING)) accepted = accept_encoding(header(HDR_ACCEPT_ENCODING));
+
+    /*
+        完整响应缓存命中时不再查文件缓存，缓存中只有通过了下面权限检查的文件。缓存的是完整响应，Range请求不查。
+        先找客户端可接受的压缩表示，再找原文件
+    */
+    if(m_response_cache && !has_header(HDR_RANGE))
+    {
+        for(int encoding = ENCODING_BR; encoding <= ENCODING_GZIP && !m_cached; encoding++)
+        {
+            if(accepted & encoding) m_cached = m_response_cache->acquire(variant_key(encoding));
+        }
+        if(!m_cached) m_cached = m_response_cache->acquire(m_real_file);
+        if(m_cached) return not_modified(m_cached->etag, m_cached->st.st_mtime) ? NOT_MODIFIED : CACHED_REQUEST;
+    }
 
-    int fd = open(m_real_file, O_RDONLY);
-    m_file_address = (char*)mmap(0, m_file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    close(fd);
+    /* stat、open和mmap都由文件缓存完成，命中时没有任何系统调用 */
+    int err = 0;
+    file_entry * file = m_file_cache->acquire(m_real_file, err);
+    if(!file) return NO_RESOURCE;
+    m_file_stat = file->st;
+    if(!(m_file_stat.st_mode & S_IROTH) || S_ISDIR(m_file_stat.st_mode))
+    {
+        file_cache::release(file);
+        return !(m_file_stat.st_mode & S_IROTH) ? FORBIDDEN_REQUEST : BAD_REQUEST;
+    }
+
+    /* 预压缩的.br/.gz文件优先，同样经过文件缓存，不存在时由负缓存记住 */
+    for(int encoding = ENCODING_BR; encoding <= ENCODING_GZIP && accepted; encoding++)
+    {
+        if(!(accepted & encoding)) continue;
+        char sidecar[FILENAME_LEN + 4];
+        strcpy(sidecar, m_real_file);
+        strcat(sidecar, encoding == ENCODING_BR ? ".br" : ".gz");
+        file_entry * compressed = m_file_cache->acquire(sidecar, err);
+        if(compressed && S_ISREG(compressed->st.st_mode) && (compressed->st.st_mode & S_IROTH) && compressed->fd != -1)
+        {
+            file_cache::release(file);
+            file = compressed;
+            m_file_stat = file->st;
+            m_encoding = encoding;
+            variant_key(encoding);
+            break;
+        }
+        file_cache::release(compressed);
+    }
+
+    /* 没有预压缩文件时交给后台压缩，本次发送原文件；压缩完成后由响应缓存提供，文件未变化时只刷新校验时间 */
+    if(m_encoding == ENCODING_IDENTITY && (accepted & ENCODING_GZIP) && m_compressor && file->addr && m_file_stat.st_size < m_sendfile_threshold)
+    {
+        m_cached = m_response_cache->revalidate(variant_key(ENCODING_GZIP), file);
+        if(m_cached)
+        {
+            file_cache::release(file);
+            return not_modified(m_cached->etag, m_cached->st.st_mtime) ? NOT_MODIFIED : CACHED_REQUEST;
+        }
+        m_compressor->submit(m_cache_key, file, type);
+    }
+
+    m_file = file;
+    m_file_address = file->addr;
+    if(not_modified(file->etag, m_file_stat.st_mtime)) return NOT_MODIFIED;
+
+    /* Range语法错误或区间太多时忽略，发送完整内容 */
+    if(has_header(HDR_RANGE) && if_range(file))
+    {
+        m_range_count = parse_range(header(HDR_RANGE), m_file_stat.st_size, m_ranges, MAX_RANGES);
+        if(m_range_count == 0) return RANGE_NOT_SATISFIABLE;
+        if(m_range_count > 0) return RANGE_REQUEST;
+    }
     return FILE_REQUEST;
 }
 
 
-/*对内存映射区执行munmap操作*/
-void http_conn::unmap()
+/* 压缩表示在响应缓存中的键："路径\t编码"，URL中不会出现制表符，不会与真实文件冲突 */
+const char * http_conn::variant_key(int encoding)
+{
+    size_t len = strlen(m_real_file);
+    memcpy(m_cache_key, m_real_file, len);
+    m_cache_key[len] = '\t';
+    strcpy(m_cache_key + len + 1, encoding_name(encoding));
+    return m_cache_key;
+}
+
+
+/* If-Range是实体标签时要求强比较相等(弱标签永远不相等)，是日期时要求与修改时间相同 */
+bool http_conn::if_range(const file_entry * file) const
 {
-    if(m_file_address)
+    if(!has_header(HDR_IF_RANGE)) return true;
+    std::string_view value = header(HDR_IF_RANGE);
+    if(!value.empty() && (value[0] == '"' || value[0] == 'W')) return value == file->etag;
+    time_t date = parse_http_date(value);
+    return date != -1 && date == file->st.st_mtime;
+}
+
+
+/* 有If-None-Match时只比较ETag，否则比较If-Modified-Since，格式不对的日期按没有该头部处理 */
+bool http_conn::not_modified(const char * etag, time_t mtime) const
+{
+    if(has_header(HDR_IF_NONE_MATCH)) return etag_match(header(HDR_IF_NONE_MATCH), etag);
+    if(has_header(HDR_IF_MODIFIED_SINCE))
     {
-        munmap(m_file_address, m_file_stat.st_size);
-        m_file_address = 0;
+        time_t since = parse_http_date(header(HDR_IF_MODIFIED_SINCE));
+        return since != -1 && mtime <= since;
     }
+    return false;
 }
 
 
-bool http_conn::add_response(const char* format, ...)
+/*释放文件缓存条目的引用，映射由缓存统一管理，最后一个使用者释放时才munmap*/
+/* 单反应堆模式下工作线程和定时器可能同时释放，用原子交换保证共享条目的引用只被归还一次 */
+void http_conn::unmap()
 {
-    if(m_write_idx >= WRITE_BUFFER_SIZE) return false;
-    va_list arg_list;
-    va_start(arg_list, format);
-    int len = vsnprintf(m_write_buf + m_write_idx, WRITE_BUFFER_SIZE - 1 - m_write_idx, format, arg_list);
-    if(len >= (WRITE_BUFFER_SIZE - 1 - m_write_idx)) return false;
-    m_write_idx += len;
-    va_end(arg_list);
-    return true;
+    file_entry * file = __atomic_exchange_n(&m_file, (file_entry *)NULL, __ATOMIC_ACQ_REL);
+    if(file) file_cache::release(file);
+    int count = __atomic_exchange_n(&m_file_count, 0, __ATOMIC_ACQ_REL);
+    for(int i = 0; i < count; i++) file_cache::release(m_files[i]);
+    cached_response * cached = __atomic_exchange_n(&m_cached, (cached_response *)NULL, __ATOMIC_ACQ_REL);
+    if(cached) response_cache::release(cached);
+    count = __atomic_exchange_n(&m_hit_count, 0, __ATOMIC_ACQ_REL);
+    for(int i = 0; i < count; i++) response_cache::release(m_hits[i]);
+    m_file_address = 0;
 }
 
 
+/* 只拷贝定长字段，字符串不格式化；io_uring后端accept时没有对端地址，第一次记录时再getpeername */
+void http_conn::log_access(size_t out_before)
+{
+    if(m_address.sin_family == 0)
+    {
+        socklen_t len = sizeof(m_address);
+        if(getpeername(m_sockfd, (struct sockaddr *)&m_address, &len) < 0) m_address.sin_family = AF_UNSPEC;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    access_record record;
+    record.time_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    record.bytes = m_out.bytes() - out_before + (m_sendfile ? m_file_end - m_file_offset : 0);
+    for(int i = m_slice_next; i < m_slice_count; i++) record.bytes += m_slices[i].header_len + m_slices[i].end - m_slices[i].first;
+    record.latency_us = m_request_begin ? (uint32_t)(monotonic_us() - m_request_begin) : 0;
+    record.addr = m_address.sin_addr.s_addr;
+    record.port = ntohs(m_address.sin_port);
+    record.status = m_status;
+    record.method = m_method;
+    record.reserved = 0;
+    size_t url_len = m_url ? strlen(m_url) : 0;
+    record.url_len = url_len > UINT16_MAX ? UINT16_MAX : url_len;
+    size_t copy = std::min(url_len, (size_t)ACCESS_URL_LEN);
+    if(copy) memcpy(record.url, m_url, copy);
+    memset(record.url + copy, 0, ACCESS_URL_LEN - copy);
+    access_log::write(record);
+}
+
+
+/* 组装响应的各个部分，直接写入输出链，内存不足时返回false */
 bool http_conn::add_content(const char* content)
 {
-    return add_response("%s", content);
+    return m_out.add_ref(content, strlen(content));
 }
 
 
-bool http_conn::add_status_line(int status, const char* title)
+bool http_conn::add_status_line(int status)
 {
-    return add_response("%s %d %s\r\n", "HTTP/1.1", status, title);
+    m_status = status;
+    if(status >= 200 && status < 600) metrics::add((METRIC_COUNTER)(CNT_STATUS_2XX + status / 100 - 2));
+    std::string_view head = response_head(status, m_linger);
+    char * p = m_out.reserve(head.size() + DATE_HEADER_LEN);
+    if(!p) return false;
+    memcpy(p, head.data(), head.size());
+    date_header(p + head.size());
+    return m_out.commit(head.size() + DATE_HEADER_LEN);
 }
 
 
-bool http_conn::add_headers(int content_len)
+bool http_conn::add_header(std::string_view name, std::string_view value)
 {
-    add_content_length(content_len);
-    add_linger();
-    add_blank_line();
+    size_t len = name.size() + 2 + value.size() + 2;
+    char * p = m_out.reserve(len);
+    if(!p) return false;
+    memcpy(p, name.data(), name.size());
+    p += name.size();
+    *p++ = ':';
+    *p++ = ' ';
+    memcpy(p, value.data(), value.size());
+    p += value.size();
+    *p++ = '\r';
+    *p++ = '\n';
+    return m_out.commit(len);
 }
 
-bool http_conn::add_content_length(int content_len)
+
+bool http_conn::add_headers(off_t content_len, std::string_view type)
 {
-    return add_response("Content-Length: %d\r\n", content_len);
+    static const char LENGTH[] = "Content-Length: ";
+    if(!add_header("Content-Type", type)) return false;
+    char * start = m_out.reserve(sizeof(LENGTH) + 20 + 4);
+    if(!start) return false;
+    memcpy(start, LENGTH, sizeof(LENGTH) - 1);
+    char * p = format_uint(start + sizeof(LENGTH) - 1, content_len);
+    memcpy(p, "\r\n\r\n", 4);
+    return m_out.commit(p + 4 - start);
 }
 
 
-bool http_conn::add_linger()
+/* "bytes first-last/size" */
+static char * format_content_range(char * p, const byte_range & r, off_t size)
 {
-    return add_response("Connection: %s\r\n", (m_linger == true) ? "keep-alive" : "close");
+    memcpy(p, "bytes ", 6);
+    p = format_uint(p + 6, r.first);
+    *p++ = '-';
+    p = format_uint(p, r.last);
+    *p++ = '/';
+    return format_uint(p, size);
 }
 
 
-bool http_conn::add_blank_line()
+/*
+    单个区间直接发送映射中的一段或sendfile发送文件的一段；
+    多个区间组成multipart/byteranges，每段的分隔行和头部在请求级内存池中生成，与映射中的各段交替放入输出链；
+    没有映射的大文件只把第一段的头部放入输出链，其余各段记入m_slices，由write()在每段sendfile完毕后依次接上。
+*/
+bool http_conn::add_ranges(std::string_view type)
 {
-    return add_response("%s", "\r\n");
+    static std::atomic<uint64_t> boundary_seq((uint64_t)time(NULL) << 20);
+    static const int PART_HEADER_LEN = 4 + 20 + 16 + MAX_TYPE_LEN + 17 + 6 + 20 * 3 + 2 + 4;
+
+    off_t size = m_file_stat.st_size;
+    type = type.substr(0, MAX_TYPE_LEN);
+    file_entry * file = m_file;
+    m_file = NULL;
+    m_files[m_file_count++] = file;
+
+    if(m_range_count == 1)
+    {
+        const byte_range & r = m_ranges[0];
+        char range[6 + 20 * 3 + 2];
+        char * end = format_content_range(range, r, size);
+        if(!add_header("Content-Range", std::string_view(range, end - range)) || !add_headers(r.last - r.first + 1, type)) return false;
+        if(!m_file_address)
+        {
+            m_sendfile = true;
+            m_sendfile_entry = file;
+            m_file_offset = r.first;
+            m_file_end = r.last + 1;
+            return true;
+        }
+        return m_out.add_ref(m_file_address + r.first, r.last - r.first + 1);
+    }
+
+    char boundary[20];
+    size_t boundary_len = format_uint(boundary, boundary_seq.fetch_add(1, std::memory_order_relaxed)) - boundary;
+
+    /* 先生成各段头部，算出总长度 */
+    char * parts[MAX_RANGES];
+    size_t part_len[MAX_RANGES];
+    off_t total = 0;
+    for(int i = 0; i < m_range_count; i++)
+    {
+        char * p = parts[i] = (char *)m_arena.allocate(PART_HEADER_LEN, 1);
+        memcpy(p, "\r\n--", 4);
+        memcpy(p + 4, boundary, boundary_len);
+        p += 4 + boundary_len;
+        memcpy(p, "\r\nContent-Type: ", 16);
+        memcpy(p + 16, type.data(), type.size());
+        p += 16 + type.size();
+        memcpy(p, "\r\nContent-Range: ", 17);
+        p = format_content_range(p + 17, m_ranges[i], size);
+        memcpy(p, "\r\n\r\n", 4);
+        part_len[i] = p + 4 - parts[i];
+        total += part_len[i] + m_ranges[i].last - m_ranges[i].first + 1;
+    }
+    char * tail = (char *)m_arena.allocate(4 + boundary_len + 4, 1);
+    memcpy(tail, "\r\n--", 4);
+    memcpy(tail + 4, boundary, boundary_len);
+    memcpy(tail + 4 + boundary_len, "--\r\n", 4);
+    total += 4 + boundary_len + 4;
+
+    static const char MULTIPART[] = "multipart/byteranges; boundary=";
+    char multipart[sizeof(MULTIPART) + 20];
+    memcpy(multipart, MULTIPART, sizeof(MULTIPART) - 1);
+    memcpy(multipart + sizeof(MULTIPART) - 1, boundary, boundary_len);
+    if(!add_headers(total, std::string_view(multipart, sizeof(MULTIPART) - 1 + boundary_len))) return false;
+
+    if(!m_file_address)
+    {
+        file_slice * slices = (file_slice *)m_arena.allocate(sizeof(file_slice) * m_range_count, alignof(file_slice));
+        for(int i = 1; i < m_range_count; i++) slices[i - 1] = { parts[i], part_len[i], m_ranges[i].first, m_ranges[i].last + 1 };
+        slices[m_range_count - 1] = { tail, 4 + boundary_len + 4, 0, 0 };
+        m_slices = slices;
+        m_slice_count = m_range_count;
+        m_slice_next = 0;
+
+        m_sendfile = true;
+        m_sendfile_entry = file;
+        m_file_offset = m_ranges[0].first;
+        m_file_end = m_ranges[0].last + 1;
+        return m_out.add_ref(parts[0], part_len[0]);
+    }
+
+    for(int i = 0; i < m_range_count; i++)
+    {
+        if(!m_out.add_ref(parts[i], part_len[i])) return false;
+        if(!m_out.add_ref(m_file_address + m_ranges[i].first, m_ranges[i].last - m_ranges[i].first + 1)) return false;
+    }
+    return m_out.add_ref(tail, 4 + boundary_len + 4);
 }
 
 
+bool http_conn::add_error(int status, const char * form)
+{
+    return add_status_line(status) && add_headers(strlen(form), "text/plain; charset=utf-8") && add_content(form);
+}
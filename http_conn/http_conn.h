@@ -7,10 +7,10 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <stdio.h>
-#include<stdarg.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <limits.h>
 #include <string.h>
 #include <sys/uio.h>
 #include <sys/stat.h>
@@ -18,15 +18,29 @@
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <atomic>
+#include <algorithm>
+#include <string_view>
 
 #include "../threadpool/locker.h"
+#include "../cache/file_cache.h"
+#include "../cache/response_cache.h"
+#include "../cache/compressor.h"
+#include "../buffer/buffer_pool.h"
+#include "../buffer/arena.h"
+#include "../buffer/output_chain.h"
+#include "../log/access_log.h"
+#include "../metrics/metrics.h"
+#include "http_header.h"
+#include "http_response.h"
 
 class http_conn
 {
     public:
         static const int FILENAME_LEN = 200;
-        static const int READ_BUFFER_SIZE = 2048;
-        static const int WRITE_BUFFER_SIZE = 1024;
+        static const int MAX_PIPELINE = 16;                 //一批最多排队的流水线响应数
+        static const int MAX_HEADERS = 64;                  //一个请求最多的头部数，超出时按错误请求处理
+        static const int MAX_RANGES = 16;                   //一个Range头部最多的区间数(合并后)，超出时忽略Range
         enum METHOD
         {
             GET = 0,
@@ -53,8 +67,14 @@ class http_conn
             NO_RESOURCE,
             FORBIDDEN_REQUEST,
             FILE_REQUEST,
+            CACHED_REQUEST,
+            NOT_MODIFIED,
+            RANGE_REQUEST,
+            RANGE_NOT_SATISFIABLE,
+            METRICS_REQUEST,
             INTERVAL_ERROR,
-            CLOSED_CONNECTION
+            CLOSED_CONNECTION,
+            HEADER_TOO_LARGE
         };
         enum LINE_STATUS
         {
@@ -65,17 +85,46 @@ class http_conn
 
     /* 成员接口函数 */
     public:
-        http_conn(){};
+        http_conn() : m_read_buf(NULL), m_read_size(0) {};
         ~http_conn(){};
 
-        void init(int socketfd, const sockaddr_in &addr);   //初始化连接
+        void init(int socketfd, const sockaddr_in &addr, int epollfd);   //初始化连接，epollfd为所属reactor的epoll实例
         void close_conn(bool real_close = true);            //关闭连接
-        void process();                                     //入口函数
+        bool process();                                     //入口函数，返回false表示连接已被关闭
         bool read();
         bool write();
+
+        /* io_uring后端使用的接口：数据由内核收进provided buffer，响应由SENDMSG发送 */
+        int read(const char * data, int len);               //把已收到的数据追加到读缓冲区，返回放得下的字节数
+        int response_iov(struct iovec ** iv);               //待发送响应的iovec个数，sendfile模式返回0，需调用write()
+        bool response_sent() { return finish_write(); }     //SENDMSG发送完毕，返回是否保持连接
+        bool linger() const { return m_keep_alive; }        //这一批响应发送完毕后是否保持连接
+        bool writing() const { return m_out.count() > 0; }  //响应是否还未发送完毕
+        bool pending_input() const { return m_deferred; }   //读缓冲区中还有留到下一批处理的请求
+
+        /* 线程池记录的入队时间，用于统计排队耗时 */
+        void set_queued(uint64_t us) { m_queued_at = us; }
+        uint64_t queued() const { return m_queued_at; }
+
+        /* 当前请求的头部，指向读缓冲区，只在该请求的响应组装完成之前有效 */
+        int header_count() const { return m_header_count; }
+        std::string_view header_name(int i) const { return field(m_headers[i].name_off, m_headers[i].name_len); }
+        std::string_view header_value(int i) const { return field(m_headers[i].value_off, m_headers[i].value_len); }
+        bool has_header(HEADER_ID id) const { return m_known[id] >= 0; }
+        std::string_view header(HEADER_ID id) const { return m_known[id] < 0 ? std::string_view() : header_value(m_known[id]); }
+
+        /* 请求级内存池，分配的内存在这一批响应发送完毕后一起释放，可交给std::pmr容器 */
+        std::pmr::memory_resource * arena() { return &m_arena; }
+        const request_arena::stats & arena_stats() const { return m_arena.last(); }    //上一批请求的分配统计
     
     private:
+        friend class parser_bench;                          //bench/parser_bench.cpp不经过socket直接驱动解析状态机
+
         void init();
+        void init_request();
+        void compact();                                     //把未处理完的数据移到读缓冲区开头
+        bool reserve_read();                                //保证读缓冲区有空闲空间，已到最大规格且占满时返回false
+        void release_read();                                //读缓冲区没有数据时交还缓冲池
         HTTP_CODE process_read();                           //处理请求消息
         bool process_write(HTTP_CODE ret);                  //根据解析结果处理响应消息
 
@@ -83,48 +132,96 @@ class http_conn
         char *get_line() { return m_start_line + m_read_buf; }
         HTTP_CODE parse_request_line(char * text);
         HTTP_CODE parse_headers(char * text);
+        std::string_view field(uint16_t off, uint16_t len) const { return std::string_view(m_read_buf + m_request_start + off, len); }
         HTTP_CODE parse_content(char * text);
         HTTP_CODE do_request();                             //请求消息处理的返回值函数
-
-        void unmap();
-        bool add_response(const char * format, ...);
-        bool add_content(const char * content);
-        bool add_status_line(int status, const char *title);
-        bool add_headers(int content_length);
-        bool add_content_length(int content_length);
-        bool add_linger();
-        bool add_blank_line();
+        HTTP_CODE timed_request(uint64_t parse_begin);      //请求完整后调用do_request，启用指标时统计解析和处理的耗时
+        bool not_modified(const char * etag, time_t mtime) const;     //条件请求的验证器是否与文件一致
+        bool if_range(const file_entry * file) const;       //没有If-Range或其验证器与文件一致时才按Range响应
+        const char * variant_key(int encoding);             //生成压缩表示在响应缓存中的键，写入m_cache_key
+
+        void unmap();                                       //释放对文件缓存和响应缓存条目的引用
+        bool finish_write();                                //响应发送完毕后的处理
+        void input_arrived();                               //读到新数据：结束空闲状态，统计accept到第一次读的耗时
+        void set_idle(bool idle);                           //长连接进入或离开空闲状态，更新空闲连接数
+        bool add_content(const char * content);             //静态字符串，不复制
+        bool add_status_line(int status);                   //预组装的状态行和固定头部，加上Date
+        bool add_header(std::string_view name, std::string_view value);
+        bool add_headers(off_t content_length, std::string_view type);     //Content-Type、Content-Length和空行
+        bool add_error(int status, const char * form);
+        bool add_ranges(std::string_view type);             //206响应的Content-Range等头部和各区间的内容
+        void log_access(size_t out_before);                 //写一条访问日志，out_before为组装响应前输出链的字节数
 
 
     /* 成员变量 */
     public:
-        static int m_epollfd;
-        static int m_user_count;
+        static std::atomic<int> m_user_count;               //各reactor线程和工作线程并发增减
+        static file_cache * m_file_cache;                   //所有连接共享的打开文件缓存
+        static response_cache * m_response_cache;           //小文件的完整响应缓存，NULL表示不使用
+        static compressor * m_compressor;                   //后台gzip压缩，NULL表示只使用预压缩文件
+        static off_t m_sendfile_threshold;                  //不小于该大小的文件用sendfile发送，小文件从映射writev
+        static int m_header_limit;                          //请求行加头部的最大字节数，超出时响应431
     
     private:
+        /* 热字段：每次读写和解析都会访问，放在对象开头 */
+        int m_epollfd;
         CHECK_STATE m_check_state;
         METHOD m_method;
         int m_sockfd;
-        sockaddr_in m_address;
         
-        char m_read_buf[READ_BUFFER_SIZE];
-        char m_write_buf[WRITE_BUFFER_SIZE];
+        char * m_read_buf;                                  //从buffer_pool取得，没有未处理的数据时为NULL
+        int m_read_size;
         int m_read_idx;
-        int m_write_idx;
         int m_check_idx;
         int m_start_line;
+        int m_request_start;                                //当前请求在读缓冲区中的起始位置
+        bool m_deferred;                                    //还有请求留到下一批处理
+        bool m_keep_alive;                                  //这一批最后一个响应是否保持连接
 
+        char * m_line_end;                                  //parse_line()得到的当前行的结尾('\0'的位置)
         char * m_url;
-        char * m_host;
         char * m_version;
         bool m_linger;
         int m_content_length;
-        char m_real_file[FILENAME_LEN];
+        int m_body_left;                                    //消息体还未到达的字节数
+        int m_header_count;
 
-        struct stat m_file_stat;
+        file_entry * m_file;                                //当前请求引用的文件缓存条目
         char * m_file_address;
-        struct iovec m_iv[2];
-        int m_iv_count;
+        int m_file_count;
+        cached_response * m_cached;                         //当前请求命中的响应缓存条目
+        int m_encoding;                                     //当前响应的内容编码(CONTENT_ENCODING)
+        bool m_vary;                                        //当前响应随Accept-Encoding变化
+        int m_hit_count;
+        int m_responses;                                    //这一批中的响应数
+        int m_status;                                       //当前响应的状态码
+        uint64_t m_request_begin;                           //开始解析当前请求的时间(CLOCK_MONOTONIC，微秒)，访问日志使用
+        uint64_t m_accept_at;                               //accept的时间，第一次读到数据后清零，以下时间只在启用指标时记录
+        uint64_t m_queued_at;                               //最近一次进入线程池队列的时间
+        uint64_t m_write_begin;                             //这一批响应开始发送的时间
+        bool m_idle;                                        //是否计入空闲连接数
+
+        bool m_sendfile;                                    //这一批最后一个响应是否使用sendfile发送文件内容
+        file_entry * m_sendfile_entry;
+        off_t m_file_offset;                                //sendfile模式下下一次发送的文件偏移，跨EAGAIN保持
+        off_t m_file_end;
+        file_slice * m_slices;                              //当前区间之后还要发送的各段，在请求级内存池中
+        int m_slice_count;
+        int m_slice_next;
+
+        /* 冷字段：较大的数组，只在组装响应或查找头部时访问到其中一部分，放在对象末尾 */
+        sockaddr_in m_address;
+        int8_t m_known[HDR_COUNT];                          //已知头部第一次出现在m_headers中的下标，没有时为-1
+        file_entry * m_files[MAX_PIPELINE];                 //这一批响应持有的文件缓存条目
+        cached_response * m_hits[MAX_PIPELINE];             //这一批响应持有的响应缓存条目
+        struct stat m_file_stat;
+        header_field m_headers[MAX_HEADERS];                //当前请求的头部，按出现顺序排列
+        byte_range m_ranges[MAX_RANGES];                    //当前请求的Range区间
+        int m_range_count;
+        char m_real_file[FILENAME_LEN];
+        char m_cache_key[FILENAME_LEN + 8];                 //压缩表示在响应缓存中的键
+        output_chain m_out;                                 //这一批响应的输出链
+        request_arena m_arena;
 };
 
 
@@ -0,0 +1,153 @@
+#ifndef HTTP_HEADER_H
+#define HTTP_HEADER_H
+
+/*
+    请求头部表：
+    每个头部只记录名称和值在读缓冲区中的(偏移, 长度)，不拷贝、不分配内存。
+    常用头部名称在编译期生成的完美哈希表中查找，得到HEADER_ID后按下标O(1)访问，
+    不再逐个strncasecmp比较。
+*/
+
+#include <stdint.h>
+#include <strings.h>
+
+
+enum HEADER_ID
+{
+    HDR_UNKNOWN = 0,
+    HDR_HOST,
+    HDR_CONNECTION,
+    HDR_CONTENT_LENGTH,
+    HDR_CONTENT_TYPE,
+    HDR_TRANSFER_ENCODING,
+    HDR_ACCEPT,
+    HDR_ACCEPT_ENCODING,
+    HDR_ACCEPT_LANGUAGE,
+    HDR_USER_AGENT,
+    HDR_REFERER,
+    HDR_COOKIE,
+    HDR_AUTHORIZATION,
+    HDR_CACHE_CONTROL,
+    HDR_PRAGMA,
+    HDR_IF_MATCH,
+    HDR_IF_NONE_MATCH,
+    HDR_IF_MODIFIED_SINCE,
+    HDR_IF_UNMODIFIED_SINCE,
+    HDR_IF_RANGE,
+    HDR_RANGE,
+    HDR_EXPECT,
+    HDR_UPGRADE,
+    HDR_ORIGIN,
+    HDR_TE,
+    HDR_X_FORWARDED_FOR,
+    HDR_COUNT
+};
+
+
+/* 一个请求头部，偏移相对于请求在读缓冲区中的起始位置，压缩缓冲区时不需要调整 */
+struct header_field
+{
+    uint16_t name_off;
+    uint16_t name_len;
+    uint16_t value_off;
+    uint16_t value_len;
+    uint8_t id;                 //HEADER_ID
+};
+
+
+namespace header_hash
+{
+    struct known_name
+    {
+        const char * name;
+        int len;
+    };
+
+    /* 按HEADER_ID排列的小写名称 */
+    constexpr known_name KNOWN[HDR_COUNT] =
+    {
+        { "", 0 },
+        { "host", 4 },
+        { "connection", 10 },
+        { "content-length", 14 },
+        { "content-type", 12 },
+        { "transfer-encoding", 17 },
+        { "accept", 6 },
+        { "accept-encoding", 15 },
+        { "accept-language", 15 },
+        { "user-agent", 10 },
+        { "referer", 7 },
+        { "cookie", 6 },
+        { "authorization", 13 },
+        { "cache-control", 13 },
+        { "pragma", 6 },
+        { "if-match", 8 },
+        { "if-none-match", 13 },
+        { "if-modified-since", 17 },
+        { "if-unmodified-since", 19 },
+        { "if-range", 8 },
+        { "range", 5 },
+        { "expect", 6 },
+        { "upgrade", 7 },
+        { "origin", 6 },
+        { "te", 2 },
+        { "x-forwarded-for", 15 }
+    };
+
+    const unsigned SLOTS = 64;
+
+    /* 忽略大小写的FNV-1a：名称中只有字母、数字和'-'，或上0x20即可统一为小写 */
+    constexpr uint32_t hash(const char * s, int len, uint32_t seed)
+    {
+        uint32_t h = seed;
+        for(int i = 0; i < len; i++) h = (h ^ (uint8_t)(s[i] | 0x20)) * 16777619u;
+        return (h ^ (h >> 15)) & (SLOTS - 1);
+    }
+
+    /* 编译期搜索一个使所有已知名称落在不同槽位的种子 */
+    constexpr uint32_t find_seed()
+    {
+        for(uint32_t seed = 2166136261u; seed < 2166136261u + 100000; seed++)
+        {
+            bool used[SLOTS] = {};
+            bool ok = true;
+            for(int id = 1; id < HDR_COUNT && ok; id++)
+            {
+                uint32_t slot = hash(KNOWN[id].name, KNOWN[id].len, seed);
+                ok = !used[slot];
+                used[slot] = true;
+            }
+            if(ok) return seed;
+        }
+        return 0;
+    }
+
+    constexpr uint32_t SEED = find_seed();
+    static_assert(SEED != 0, "no perfect hash seed for the known header names");
+
+    struct slot_table
+    {
+        uint8_t id[SLOTS];
+    };
+
+    constexpr slot_table build()
+    {
+        slot_table table = {};
+        for(int id = 1; id < HDR_COUNT; id++) table.id[hash(KNOWN[id].name, KNOWN[id].len, SEED)] = id;
+        return table;
+    }
+
+    constexpr slot_table TABLE = build();
+}
+
+
+/* 头部名称对应的HEADER_ID，不是已知名称时返回HDR_UNKNOWN */
+inline HEADER_ID header_lookup(const char * name, int len)
+{
+    int id = header_hash::TABLE.id[header_hash::hash(name, len, header_hash::SEED)];
+    if(id != HDR_UNKNOWN && header_hash::KNOWN[id].len == len && strncasecmp(name, header_hash::KNOWN[id].name, len) == 0) return (HEADER_ID)id;
+    return HDR_UNKNOWN;
+}
+
+
+#endif
@@ -0,0 +1,485 @@
+#include <string.h>
+#include <strings.h>
+#include <atomic>
+#include <string>
+#include <algorithm>
+
+#include "http_response.h"
+
+
+/************************状态行与固定头部************************/
+
+struct status_entry
+{
+    int status;
+    const char * title;
+};
+
+static const status_entry STATUS[] =
+{
+    { 200, "OK" },
+    { 206, "Partial Content" },
+    { 304, "Not Modified" },
+    { 400, "Bad Request" },
+    { 403, "Forbidden" },
+    { 404, "Not Found" },
+    { 416, "Range Not Satisfiable" },
+    { 431, "Request Header Fields Too Large" },
+    { 500, "Internal Server Error" }
+};
+
+static const int STATUS_COUNT = sizeof(STATUS) / sizeof(STATUS[0]);
+
+
+/* 下标为STATUS中的位置*2 + keep_alive */
+static std::string * build_heads()
+{
+    std::string * heads = new std::string[STATUS_COUNT * 2];
+    for(int i = 0; i < STATUS_COUNT; i++)
+    {
+        for(int keep_alive = 0; keep_alive < 2; keep_alive++)
+        {
+            std::string & head = heads[i * 2 + keep_alive];
+            head = "HTTP/1.1 ";
+            head += std::to_string(STATUS[i].status);
+            head += ' ';
+            head += STATUS[i].title;
+            head += "\r\nServer: " SERVER_NAME "\r\nConnection: ";
+            head += keep_alive ? "keep-alive\r\n" : "close\r\n";
+        }
+    }
+    return heads;
+}
+
+static const std::string * g_heads = build_heads();
+
+
+static int status_index(int status)
+{
+    for(int i = 0; i < STATUS_COUNT; i++) if(STATUS[i].status == status) return i;
+    return STATUS_COUNT - 1;
+}
+
+
+std::string_view response_head(int status, bool keep_alive)
+{
+    return g_heads[status_index(status) * 2 + (keep_alive ? 1 : 0)];
+}
+
+
+const char * status_title(int status)
+{
+    return STATUS[status_index(status)].title;
+}
+
+
+/************************数字与日期格式化************************/
+
+static const char DIGITS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+
+/* 从低位开始每次转换两位，写到临时缓冲区末尾再整体拷贝 */
+char * format_uint(char * p, uint64_t value)
+{
+    char buf[20];
+    char * end = buf + sizeof(buf);
+    char * q = end;
+    while(value >= 100)
+    {
+        int i = (int)(value % 100) * 2;
+        value /= 100;
+        *--q = DIGITS[i + 1];
+        *--q = DIGITS[i];
+    }
+    if(value >= 10)
+    {
+        int i = (int)value * 2;
+        *--q = DIGITS[i + 1];
+        *--q = DIGITS[i];
+    }
+    else *--q = (char)('0' + value);
+
+    memcpy(p, q, end - q);
+    return p + (end - q);
+}
+
+
+static inline char * put2(char * p, int value)
+{
+    p[0] = DIGITS[value * 2];
+    p[1] = DIGITS[value * 2 + 1];
+    return p + 2;
+}
+
+
+void format_http_date(time_t t, char * out)
+{
+    static const char WEEKDAYS[] = "SunMonTueWedThuFriSat";
+    static const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    char * p = out;
+    memcpy(p, WEEKDAYS + tm.tm_wday * 3, 3);
+    p[3] = ',';
+    p[4] = ' ';
+    p = put2(p + 5, tm.tm_mday);
+    *p++ = ' ';
+    memcpy(p, MONTHS + tm.tm_mon * 3, 3);
+    p[3] = ' ';
+    p = put2(p + 4, (tm.tm_year + 1900) / 100);
+    p = put2(p, (tm.tm_year + 1900) % 100);
+    *p++ = ' ';
+    p = put2(p, tm.tm_hour);
+    *p++ = ':';
+    p = put2(p, tm.tm_min);
+    *p++ = ':';
+    p = put2(p, tm.tm_sec);
+    memcpy(p, " GMT", 4);
+}
+
+
+/************************条件请求************************/
+
+static char * format_hex(char * p, uint64_t value)
+{
+    static const char HEX[] = "0123456789abcdef";
+    char buf[16];
+    char * q = buf + sizeof(buf);
+    do
+    {
+        *--q = HEX[value & 15];
+        value >>= 4;
+    } while(value);
+    memcpy(p, q, buf + sizeof(buf) - q);
+    return p + (buf + sizeof(buf) - q);
+}
+
+
+int format_etag(const struct stat & st, char * out)
+{
+    char * p = out;
+    *p++ = '"';
+    p = format_hex(p, st.st_ino);
+    *p++ = '-';
+    p = format_hex(p, st.st_size);
+    *p++ = '-';
+    p = format_hex(p, (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec);
+    *p++ = '"';
+    *p = '\0';
+    return p - out;
+}
+
+
+static std::string_view trim_blank(std::string_view s)
+{
+    while(!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while(!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+
+/* 弱比较：忽略两边的"W/"前缀 */
+static std::string_view opaque_tag(std::string_view tag)
+{
+    if(tag.size() >= 2 && tag[0] == 'W' && tag[1] == '/') tag.remove_prefix(2);
+    return tag;
+}
+
+
+bool etag_match(std::string_view list, std::string_view etag)
+{
+    etag = opaque_tag(etag);
+    while(!list.empty())
+    {
+        size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+        item = trim_blank(item);
+        if(item == "*" || opaque_tag(item) == etag) return true;
+    }
+    return false;
+}
+
+
+static int parse2(const char * p)
+{
+    if(p[0] < '0' || p[0] > '9' || p[1] < '0' || p[1] > '9') return -1;
+    return (p[0] - '0') * 10 + (p[1] - '0');
+}
+
+
+/* "Sun, 06 Nov 1994 08:49:37 GMT"，不支持已废弃的RFC 850和asctime格式 */
+time_t parse_http_date(std::string_view value)
+{
+    static const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    if(value.size() != HTTP_DATE_LEN) return -1;
+    const char * p = value.data();
+    if(p[3] != ',' || p[4] != ' ' || p[7] != ' ' || p[11] != ' ' || p[16] != ' ' || p[19] != ':' || p[22] != ':'
+       || memcmp(p + 25, " GMT", 4) != 0) return -1;
+
+    int month = -1;
+    for(int i = 0; i < 12; i++) if(memcmp(p + 8, MONTHS + i * 3, 3) == 0) month = i;
+    int day = parse2(p + 5), century = parse2(p + 12), year = parse2(p + 14);
+    int hour = parse2(p + 17), minute = parse2(p + 20), second = parse2(p + 23);
+    if(month < 0 || day < 1 || century < 0 || year < 0 || hour < 0 || hour > 23 || minute < 0 || minute > 59
+       || second < 0 || second > 60) return -1;
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = century * 100 + year - 1900;
+    tm.tm_mon = month;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_sec = second;
+    return timegm(&tm);
+}
+
+
+/* 非负十进制整数，溢出或含非数字字符时返回false */
+static bool parse_offset(std::string_view s, off_t & value)
+{
+    if(s.empty() || s.size() > 18) return false;
+    value = 0;
+    for(char c : s)
+    {
+        if(c < '0' || c > '9') return false;
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+
+int parse_range(std::string_view value, off_t size, byte_range * ranges, int max)
+{
+    if(value.size() < 6 || strncasecmp(value.data(), "bytes=", 6) != 0) return -1;
+    value.remove_prefix(6);
+
+    int count = 0;
+    bool any = false;
+    while(!value.empty())
+    {
+        size_t comma = value.find(',');
+        std::string_view item = trim_blank(value.substr(0, comma));
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+        if(item.empty()) continue;
+
+        size_t dash = item.find('-');
+        if(dash == std::string_view::npos) return -1;
+        std::string_view first = item.substr(0, dash), last = item.substr(dash + 1);
+        byte_range r;
+        if(first.empty())
+        {
+            /* "-n"：最后n个字节 */
+            off_t suffix;
+            if(!parse_offset(last, suffix)) return -1;
+            any = true;
+            if(suffix == 0 || size == 0) continue;
+            r.first = suffix < size ? size - suffix : 0;
+            r.last = size - 1;
+        }
+        else
+        {
+            /* "a-b"或"a-" */
+            if(!parse_offset(first, r.first)) return -1;
+            r.last = size - 1;
+            if(!last.empty())
+            {
+                off_t end;
+                if(!parse_offset(last, end) || end < r.first) return -1;
+                if(end < r.last) r.last = end;
+            }
+            any = true;
+            if(r.first >= size) continue;
+        }
+        if(count == max) return -1;
+        ranges[count++] = r;
+    }
+    if(!any) return -1;
+
+    std::sort(ranges, ranges + count, [](const byte_range & a, const byte_range & b) { return a.first < b.first; });
+    int merged = 0;
+    for(int i = 0; i < count; i++)
+    {
+        if(merged > 0 && ranges[i].first <= ranges[merged - 1].last + 1)
+        {
+            ranges[merged - 1].last = std::max(ranges[merged - 1].last, ranges[i].last);
+        }
+        else ranges[merged++] = ranges[i];
+    }
+    return merged;
+}
+
+
+/************************内容编码************************/
+
+int accept_encoding(std::string_view value)
+{
+    int accepted = 0;
+    while(!value.empty())
+    {
+        size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+
+        /* "gzip;q=0.5"：只区分q是否为0 */
+        size_t semicolon = item.find(';');
+        std::string_view coding = trim_blank(item.substr(0, semicolon));
+        if(semicolon != std::string_view::npos)
+        {
+            std::string_view param = trim_blank(item.substr(semicolon + 1));
+            if(param.size() >= 3 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=')
+            {
+                bool zero = true;
+                for(char c : param.substr(2)) if(c != '0' && c != '.') zero = false;
+                if(zero) continue;
+            }
+        }
+
+        if(coding.size() == 2 && strncasecmp(coding.data(), "br", 2) == 0) accepted |= ENCODING_BR;
+        else if(coding.size() == 4 && strncasecmp(coding.data(), "gzip", 4) == 0) accepted |= ENCODING_GZIP;
+        else if(coding == "*") accepted |= ENCODING_BR | ENCODING_GZIP;
+    }
+    return accepted;
+}
+
+
+const char * encoding_name(int encoding)
+{
+    if(encoding == ENCODING_BR) return "br";
+    if(encoding == ENCODING_GZIP) return "gzip";
+    return "identity";
+}
+
+
+bool compressible(std::string_view type)
+{
+    static const char * const TYPES[] = { "application/javascript", "application/json", "application/xml", "image/svg+xml", "application/wasm" };
+    if(type.substr(0, 5) == "text/") return true;
+    for(const char * t : TYPES) if(type.substr(0, strlen(t)) == t) return true;
+    return false;
+}
+
+
+static inline char * put_string(char * p, std::string_view s)
+{
+    memcpy(p, s.data(), s.size());
+    return p + s.size();
+}
+
+
+size_t format_file_headers(char * out, const char * etag, const char * last_modified, int encoding, bool vary,
+                           off_t content_length, std::string_view type)
+{
+    char * p = put_string(out, "ETag: ");
+    p = put_string(p, etag);
+    p = put_string(p, "\r\nLast-Modified: ");
+    p = put_string(p, last_modified);
+    if(encoding != ENCODING_IDENTITY)
+    {
+        p = put_string(p, "\r\nContent-Encoding: ");
+        p = put_string(p, encoding_name(encoding));
+    }
+    if(vary) p = put_string(p, "\r\nVary: Accept-Encoding");
+    p = put_string(p, "\r\nContent-Type: ");
+    p = put_string(p, type.substr(0, MAX_TYPE_LEN));
+    p = put_string(p, "\r\nContent-Length: ");
+    p = format_uint(p, content_length);
+    p = put_string(p, "\r\n\r\n");
+    return p - out;
+}
+
+
+/************************Date缓存************************/
+
+/*
+    顺序锁：更新者把序列号改成奇数后写入，写完再改回偶数；
+    读取者拷贝前后序列号相同且为偶数时拷贝有效，否则重读。每秒只有抢到更新权的一个线程格式化一次。
+*/
+static std::atomic<unsigned> g_date_seq(0);
+static std::atomic<time_t> g_date_second(0);
+static char g_date[DATE_HEADER_LEN];
+
+
+void date_header(char * out)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    time_t now = ts.tv_sec;
+
+    time_t cached = g_date_second.load(std::memory_order_acquire);
+    if(cached != now && g_date_second.compare_exchange_strong(cached, now, std::memory_order_acq_rel))
+    {
+        g_date_seq.fetch_add(1, std::memory_order_acq_rel);
+        memcpy(g_date, "Date: ", 6);
+        format_http_date(now, g_date + 6);
+        memcpy(g_date + 6 + HTTP_DATE_LEN, "\r\n", 2);
+        g_date_seq.fetch_add(1, std::memory_order_release);
+    }
+
+    while(true)
+    {
+        unsigned seq = g_date_seq.load(std::memory_order_acquire);
+        if(seq & 1) continue;
+        memcpy(out, g_date, DATE_HEADER_LEN);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(g_date_seq.load(std::memory_order_relaxed) == seq) return;
+    }
+}
+
+
+/************************Content-Type************************/
+
+struct mime_entry
+{
+    const char * ext;
+    const char * type;
+};
+
+static const mime_entry MIME[] =
+{
+    { "html", "text/html; charset=utf-8" },
+    { "htm", "text/html; charset=utf-8" },
+    { "css", "text/css; charset=utf-8" },
+    { "js", "text/javascript; charset=utf-8" },
+    { "mjs", "text/javascript; charset=utf-8" },
+    { "json", "application/json" },
+    { "txt", "text/plain; charset=utf-8" },
+    { "xml", "application/xml" },
+    { "svg", "image/svg+xml" },
+    { "png", "image/png" },
+    { "jpg", "image/jpeg" },
+    { "jpeg", "image/jpeg" },
+    { "gif", "image/gif" },
+    { "webp", "image/webp" },
+    { "ico", "image/x-icon" },
+    { "pdf", "application/pdf" },
+    { "wasm", "application/wasm" },
+    { "woff", "font/woff" },
+    { "woff2", "font/woff2" },
+    { "mp4", "video/mp4" },
+    { "webm", "video/webm" },
+    { "mp3", "audio/mpeg" },
+    { "gz", "application/gzip" },
+    { "zip", "application/zip" }
+};
+
+
+std::string_view content_type(const char * path)
+{
+    const char * slash = strrchr(path, '/');
+    const char * dot = strrchr(slash ? slash : path, '.');
+    if(dot)
+    {
+        for(size_t i = 0; i < sizeof(MIME) / sizeof(MIME[0]); i++)
+        {
+            if(strcasecmp(dot + 1, MIME[i].ext) == 0) return MIME[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
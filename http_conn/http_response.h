@@ -0,0 +1,106 @@
+#ifndef HTTP_RESPONSE_H
+#define HTTP_RESPONSE_H
+
+/*
+    响应头部的预组装片段：
+    1.每个状态码、每种连接模式(keep-alive/close)的"状态行 + Server + Connection"在启动时拼好，直接整段拷贝；
+    2.Date头部每秒格式化一次，所有线程共享，读取方按序列号校验，不加锁；
+    3.Content-Length等数字用查表的整数格式化，Content-Type按扩展名查表，都不经过printf；
+    4.条件请求的ETag生成与比较、HTTP日期解析，以及Range头部的解析；
+    5.Accept-Encoding的协商。
+*/
+
+#include <stdint.h>
+#include <time.h>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+
+#define SERVER_NAME "HttpServer"
+
+const int HTTP_DATE_LEN = 29;                       //"Sun, 06 Nov 1994 08:49:37 GMT"
+const int DATE_HEADER_LEN = 6 + HTTP_DATE_LEN + 2;  //"Date: " + 日期 + "\r\n"
+const int ETAG_LEN = 2 + 16 * 3 + 2 + 3;            //"\"inode-size-mtime[-gz]\""，各字段为十六进制，最长的情况
+const int MAX_TYPE_LEN = 64;                        //Content-Type值的最大长度
+
+/* 内容编码，按优先级从高到低排列 */
+enum CONTENT_ENCODING
+{
+    ENCODING_IDENTITY = 0,
+    ENCODING_BR = 1,
+    ENCODING_GZIP = 2
+};
+
+/* format_file_headers()的最大长度 */
+const int FILE_HEADERS_LEN = 6 + ETAG_LEN + 17 + 32 + 20 + 6 + 25 + 16 + MAX_TYPE_LEN + 18 + 20 + 4;
+
+
+/* 状态行和固定头部，未知状态码返回500的 */
+std::string_view response_head(int status, bool keep_alive);
+
+/* 状态码的原因短语 */
+const char * status_title(int status);
+
+/* 写入当前秒的"Date: ...\r\n"，长度为DATE_HEADER_LEN */
+void date_header(char * out);
+
+/* 按RFC 7231的IMF-fixdate格式化，写入HTTP_DATE_LEN个字符，不加'\0' */
+void format_http_date(time_t t, char * out);
+
+/* 十进制格式化，返回写入的末尾 */
+char * format_uint(char * p, uint64_t value);
+
+/* 由inode、大小和修改时间(纳秒)生成强ETag，写入'\0'结尾的字符串，返回长度 */
+int format_etag(const struct stat & st, char * out);
+
+/* If-None-Match的值(逗号分隔的列表或"*")中是否有与etag弱比较相等的项 */
+bool etag_match(std::string_view list, std::string_view etag);
+
+/* 解析IMF-fixdate格式的HTTP日期，格式不对时返回-1 */
+time_t parse_http_date(std::string_view value);
+
+/* 闭区间[first, last] */
+struct byte_range
+{
+    off_t first;
+    off_t last;
+};
+
+/* sendfile发送的multipart/byteranges中第一段之后的一段：先发送header(分隔行和段头部)，再sendfile文件的[first, end)，结束分隔行的first == end */
+struct file_slice
+{
+    const char * header;
+    size_t header_len;
+    off_t first;
+    off_t end;
+};
+
+/*
+    解析"bytes=..."形式的Range，结果按起始位置排序并合并重叠或相邻的区间，返回区间数。
+    语法错误、单位不是bytes或区间数超过max时返回-1(忽略Range，发送完整内容)，
+    所有区间都超出文件大小时返回0(响应416)
+*/
+int parse_range(std::string_view value, off_t size, byte_range * ranges, int max);
+
+/* Accept-Encoding中可接受(q不为0)的编码，按位或ENCODING_BR、ENCODING_GZIP */
+int accept_encoding(std::string_view value);
+
+/* 编码名称("br"、"gzip")，用于Content-Encoding和预压缩文件的扩展名 */
+const char * encoding_name(int encoding);
+
+/* 是否值得压缩：文本、脚本、JSON、XML、SVG和wasm */
+bool compressible(std::string_view type);
+
+/*
+    文件响应Date之后的头部：ETag、Last-Modified、[Content-Encoding]、[Vary]、Content-Type、Content-Length和空行，
+    vary为true时加"Vary: Accept-Encoding"，返回长度
+*/
+size_t format_file_headers(char * out, const char * etag, const char * last_modified, int encoding, bool vary,
+                           off_t content_length, std::string_view type);
+
+/* 按文件扩展名取得MIME类型，未知扩展名为application/octet-stream */
+std::string_view content_type(const char * path);
+
+
+#endif
@@ -0,0 +1,100 @@
+#include <string.h>
+#include <immintrin.h>
+
+#include "http_scan.h"
+
+
+/* 标量实现，也用于处理向量实现剩下的不足一组的尾部 */
+static const char * eol_scalar(const char * p, const char * end)
+{
+    for(; p < end; p++) if(*p == '\r' || *p == '\n') return p;
+    return end;
+}
+
+
+static const char * any2_scalar(const char * p, const char * end, char a, char b)
+{
+    for(; p < end; p++) if(*p == a || *p == b) return p;
+    return end;
+}
+
+
+/* SSE4.2：PCMPESTRI一条指令在16字节中查找字符集合里任意字符的第一次出现 */
+__attribute__((target("sse4.2")))
+static const char * any2_sse42(const char * p, const char * end, char a, char b)
+{
+    const __m128i set = _mm_setr_epi8(a, b, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    for(; p + 16 <= end; p += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        int index = _mm_cmpestri(set, 2, chunk, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        if(index < 16) return p + index;
+    }
+    return any2_scalar(p, end, a, b);
+}
+
+
+__attribute__((target("sse4.2")))
+static const char * eol_sse42(const char * p, const char * end)
+{
+    return any2_sse42(p, end, '\r', '\n');
+}
+
+
+/* AVX2：每次比较32字节，两个比较结果合并后用movemask得到位图，第一个置位的位置就是结果 */
+__attribute__((target("avx2,bmi")))
+static const char * any2_avx2(const char * p, const char * end, char a, char b)
+{
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    for(; p + 32 <= end; p += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, va), _mm256_cmpeq_epi8(chunk, vb));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if(mask) return p + _tzcnt_u32(mask);
+    }
+    if(p + 16 <= end)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm256_castsi256_si128(va)), _mm_cmpeq_epi8(chunk, _mm256_castsi256_si128(vb)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if(mask) return p + _tzcnt_u32(mask);
+        p += 16;
+    }
+    return any2_scalar(p, end, a, b);
+}
+
+
+__attribute__((target("avx2,bmi")))
+static const char * eol_avx2(const char * p, const char * end)
+{
+    return any2_avx2(p, end, '\r', '\n');
+}
+
+
+static const scan_ops scalar_ops = { "scalar", eol_scalar, any2_scalar };
+static const scan_ops sse42_ops = { "sse4.2", eol_sse42, any2_sse42 };
+static const scan_ops avx2_ops = { "avx2", eol_avx2, any2_avx2 };
+
+
+const scan_ops * scan_select(const char * name)
+{
+    __builtin_cpu_init();
+    if(strcmp(name, "avx2") == 0) return (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi")) ? &avx2_ops : NULL;
+    if(strcmp(name, "sse4.2") == 0) return __builtin_cpu_supports("sse4.2") ? &sse42_ops : NULL;
+    if(strcmp(name, "scalar") == 0) return &scalar_ops;
+    return NULL;
+}
+
+
+static const scan_ops * scan_detect()
+{
+    const scan_ops * ops = scan_select("avx2");
+    if(!ops) ops = scan_select("sse4.2");
+    if(!ops) ops = &scalar_ops;
+    return ops;
+}
+
+
+const scan_ops * g_scan = scan_detect();
@@ -0,0 +1,40 @@
+#ifndef HTTP_SCAN_H
+#define HTTP_SCAN_H
+
+/*
+    请求行和请求头的向量化扫描：
+    按16/32字节一组查找行结束符(CR/LF)和分隔符(空格、制表符、冒号等)，代替逐字节循环和strpbrk。
+    启动时根据CPU特性选择实现：AVX2(32字节)、SSE4.2(16字节，PCMPESTRI)或标量实现。
+    只读取[p, end)范围内的字节，不会越过缓冲区末尾。
+*/
+
+#include <stddef.h>
+
+
+struct scan_ops
+{
+    const char * name;
+    const char * (*eol)(const char * p, const char * end);                    //第一个'\r'或'\n'
+    const char * (*any2)(const char * p, const char * end, char a, char b);   //第一个a或b
+};
+
+/* 当前CPU上使用的实现 */
+extern const scan_ops * g_scan;
+
+/* 按名称("avx2"、"sse4.2"、"scalar")取得某个实现，CPU不支持时返回NULL，供基准测试比较 */
+const scan_ops * scan_select(const char * name);
+
+/* 返回[p, end)中第一个'\r'或'\n'的位置，没有则返回end */
+inline const char * scan_eol(const char * p, const char * end)
+{
+    return g_scan->eol(p, end);
+}
+
+/* 返回[p, end)中第一个a或b的位置，没有则返回end */
+inline const char * scan_any2(const char * p, const char * end, char a, char b)
+{
+    return g_scan->any2(p, end, a, b);
+}
+
+
+#endif
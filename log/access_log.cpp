@@ -0,0 +1,122 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "access_log.h"
+#include "log.h"
+
+
+const char * access_log::m_dir = NULL;
+size_t access_log::m_file_size = 0;
+int access_log::m_keep = 0;
+
+
+/* 线程自己的日志文件，线程退出时解除映射 */
+struct access_writer
+{
+    int seq;
+    access_log_header * header;
+    access_record * records;
+    size_t map_size;
+
+    access_writer() : seq(-1), header(NULL), records(NULL), map_size(0) {}
+    ~access_writer() { close_file(); }
+
+    void close_file()
+    {
+        if(header) munmap(header, map_size);
+        header = NULL;
+    }
+
+    bool open_next(const char * dir, size_t file_size, int keep);
+};
+
+
+static void file_name(char * out, size_t len, const char * dir, int tid, int seq)
+{
+    snprintf(out, len, "%s/access-%d-%d-%d.bin", dir, (int)getpid(), tid, seq);
+}
+
+
+bool access_writer::open_next(const char * dir, size_t file_size, int keep)
+{
+    close_file();
+    seq++;
+    int tid = (int)syscall(SYS_gettid);
+    char path[512];
+    if(seq >= keep)
+    {
+        file_name(path, sizeof(path), dir, tid, seq - keep);
+        unlink(path);
+    }
+
+    file_name(path, sizeof(path), dir, tid, seq);
+    int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0)
+    {
+        LOG_ERROR("access log open %s failure, errno is : %d", path, errno);
+        return false;
+    }
+    if(ftruncate(fd, file_size) < 0)
+    {
+        LOG_ERROR("access log ftruncate failure, errno is : %d", errno);
+        close(fd);
+        return false;
+    }
+    void * addr = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED)
+    {
+        LOG_ERROR("access log mmap failure, errno is : %d", errno);
+        return false;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    header = (access_log_header *)addr;
+    memcpy(header->magic, ACCESS_LOG_MAGIC, 8);
+    header->version = ACCESS_LOG_VERSION;
+    header->record_size = sizeof(access_record);
+    header->capacity = (file_size - sizeof(access_log_header)) / sizeof(access_record);
+    header->count = 0;
+    header->pid = getpid();
+    header->tid = tid;
+    header->seq = seq;
+    header->created_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    records = (access_record *)(header + 1);
+    map_size = file_size;
+    return true;
+}
+
+
+static thread_local access_writer t_writer;
+
+
+bool access_log::open(const char * dir, size_t file_size, int keep)
+{
+    if(file_size < sizeof(access_log_header) + sizeof(access_record) || keep <= 0) return false;
+    if(mkdir(dir, 0755) < 0 && errno != EEXIST) return false;
+    m_dir = dir;
+    m_file_size = file_size;
+    m_keep = keep;
+    return true;
+}
+
+
+void access_log::write(const access_record & record)
+{
+    access_writer & w = t_writer;
+    if(!w.header || w.header->count == w.header->capacity)
+    {
+        if(!w.open_next(m_dir, m_file_size, m_keep)) return;
+    }
+    uint64_t count = w.header->count;
+    w.records[count] = record;
+    __atomic_store_n(&w.header->count, count + 1, __ATOMIC_RELEASE);
+}
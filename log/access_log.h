@@ -0,0 +1,72 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+/*
+    二进制访问日志：
+    每个工作线程一个映射到内存的日志文件，每个请求写入一条128字节的定长记录，请求路径上没有格式化、没有系统调用。
+    1.文件开头是access_log_header，其中count为已写入的记录数，写完一条记录后才递增，读取方只读前count条；
+    2.文件写满时换下一个序号的文件，每个线程只保留最近keep个文件，更早的删除，形成按大小轮转的环；
+    3.文件名为<dir>/access-<pid>-<tid>-<seq>.bin，由tools/access_log_dump转换成文本或JSON。
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+#define ACCESS_LOG_MAGIC "HSACCLOG"
+const uint32_t ACCESS_LOG_VERSION = 1;
+const int ACCESS_URL_LEN = 92;
+
+
+struct access_log_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;                      //文件能容纳的记录数
+    uint64_t count;                         //已写入的记录数，原子地递增
+    uint32_t pid;
+    uint32_t tid;
+    uint32_t seq;
+    uint32_t reserved;
+    uint64_t created_us;                    //创建时间(CLOCK_REALTIME，微秒)
+    char padding[8];
+};
+
+
+struct access_record
+{
+    uint64_t time_us;                       //响应组装完成的时间(CLOCK_REALTIME，微秒)
+    uint64_t bytes;                         //响应的字节数，包括头部
+    uint32_t latency_us;                    //从开始解析请求到响应组装完成
+    uint32_t addr;                          //客户端IPv4地址，网络字节序
+    uint16_t port;                          //客户端端口，主机字节序
+    uint16_t status;
+    uint16_t url_len;                       //URL的原始长度，超过ACCESS_URL_LEN时只保存前面部分
+    uint8_t method;
+    uint8_t reserved;
+    char url[ACCESS_URL_LEN];
+};
+
+static_assert(sizeof(access_log_header) == 64, "access log header must stay 64 bytes");
+static_assert(sizeof(access_record) == 128, "access record must stay 128 bytes");
+
+
+class access_log
+{
+    public:
+        /* 启用访问日志，file_size为每个文件的大小上限，keep为每个线程保留的文件数 */
+        static bool open(const char * dir, size_t file_size = 64 * 1024 * 1024, int keep = 4);
+        static bool enabled() { return m_dir != NULL; }
+
+        /* 写入当前线程的日志文件，文件打开失败时丢弃 */
+        static void write(const access_record & record);
+
+    private:
+        static const char * m_dir;
+        static size_t m_file_size;
+        static int m_keep;
+};
+
+
+#endif
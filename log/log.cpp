@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "../threadpool/locker.h"
+#include "../timer/clock.h"
+
+
+static const char * const LEVEL_NAMES[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+static const int RECORD_SIZE = 256;
+static const uint32_t RING_SIZE = 512;                  //每个线程的记录数，2的幂
+static const int FLUSH_INTERVAL_US = 5000;
+
+
+/* 定长记录，正文超出时截断 */
+struct log_record
+{
+    uint64_t time_ms;                                   //CLOCK_REALTIME，毫秒
+    uint16_t len;
+    uint8_t level;
+    char text[RECORD_SIZE - 11];
+};
+
+
+/* 单生产者(所属线程)单消费者(刷写线程)的环 */
+struct log_ring
+{
+    alignas(64) std::atomic<uint32_t> head;             //生产者写入的下一个位置
+    alignas(64) std::atomic<uint32_t> tail;             //消费者读取的下一个位置
+    std::atomic<bool> closed;                           //所属线程已退出，读空后由刷写线程释放
+    log_ring * next;
+    log_record records[RING_SIZE];
+
+    log_ring() : head(0), tail(0), closed(false), next(NULL) {}
+};
+
+
+/* 线程退出时标记自己的环，环本身由刷写线程释放 */
+struct ring_holder
+{
+    log_ring * ring;
+
+    ~ring_holder() { if(ring) ring->closed.store(true, std::memory_order_release); }
+};
+
+
+static locker g_lock;                                   //保护环链表，只在线程第一次写日志和刷写时获取
+static log_ring * g_rings = NULL;
+static std::atomic<bool> g_running(false);
+static pthread_t g_flusher;
+static int g_fd = 1;
+static std::atomic<uint64_t> g_dropped(0);
+static thread_local ring_holder t_holder;
+
+
+static uint64_t realtime_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+static void write_all(const char * data, size_t len)
+{
+    while(len > 0)
+    {
+        ssize_t n = write(g_fd, data, len);
+        if(n < 0)
+        {
+            if(errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+
+/* "2024-05-17 08:49:37.123 INFO  text\n"，秒以上的部分每秒只格式化一次 */
+static size_t format_line(char * out, uint64_t time_ms, int level, const char * text, size_t len)
+{
+    static thread_local time_t cached_sec = -1;
+    static thread_local char cached[20];
+
+    time_t sec = time_ms / 1000;
+    if(sec != cached_sec)
+    {
+        struct tm tm;
+        localtime_r(&sec, &tm);
+        strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &tm);
+        cached_sec = sec;
+    }
+    int n = sprintf(out, "%s.%03u %-5s ", cached, (unsigned)(time_ms % 1000), LEVEL_NAMES[level]);
+    memcpy(out + n, text, len);
+    out[n + len] = '\n';
+    return n + len + 1;
+}
+
+
+static log_ring * local_ring()
+{
+    if(t_holder.ring) return t_holder.ring;
+    log_ring * ring = new log_ring;
+    g_lock.lock();
+    ring->next = g_rings;
+    g_rings = ring;
+    g_lock.unlock();
+    t_holder.ring = ring;
+    return ring;
+}
+
+
+void log_write(int level, const char * format, ...)
+{
+    va_list args;
+    va_start(args, format);
+
+    if(!g_running.load(std::memory_order_acquire))
+    {
+        /* 刷写线程没有运行，同步写出 */
+        char text[RECORD_SIZE], line[RECORD_SIZE + 64];
+        int len = vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+        if(len < 0) return;
+        if(len >= (int)sizeof(text)) len = sizeof(text) - 1;
+        write_all(line, format_line(line, realtime_ms(), level, text, len));
+        return;
+    }
+
+    log_ring * ring = local_ring();
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    if(head - ring->tail.load(std::memory_order_acquire) == RING_SIZE)
+    {
+        va_end(args);
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    log_record & record = ring->records[head & (RING_SIZE - 1)];
+    int len = vsnprintf(record.text, sizeof(record.text), format, args);
+    va_end(args);
+    if(len < 0) len = 0;
+    if(len >= (int)sizeof(record.text)) len = sizeof(record.text) - 1;
+    record.len = len;
+    record.level = level;
+    record.time_ms = realtime_ms();
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+
+/* 读空所有环，攒满一块再write；已退出线程的空环从链表中摘除并释放 */
+static void drain()
+{
+    static char buf[64 * 1024];
+    size_t used = 0;
+
+    g_lock.lock();
+    log_ring ** link = &g_rings;
+    while(*link)
+    {
+        log_ring * ring = *link;
+        bool closed = ring->closed.load(std::memory_order_acquire);
+        uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint32_t head = ring->head.load(std::memory_order_acquire);
+        for(; tail != head; tail++)
+        {
+            const log_record & record = ring->records[tail & (RING_SIZE - 1)];
+            if(used + RECORD_SIZE + 64 > sizeof(buf))
+            {
+                write_all(buf, used);
+                used = 0;
+            }
+            used += format_line(buf + used, record.time_ms, record.level, record.text, record.len);
+        }
+        ring->tail.store(tail, std::memory_order_release);
+
+        if(closed)
+        {
+            *link = ring->next;
+            delete ring;
+        }
+        else link = &ring->next;
+    }
+    g_lock.unlock();
+    if(used) write_all(buf, used);
+}
+
+
+static void * flusher(void *)
+{
+    while(g_running.load(std::memory_order_acquire))
+    {
+        drain();
+        usleep(FLUSH_INTERVAL_US);
+    }
+    return NULL;
+}
+
+
+void log_init(int fd)
+{
+    if(g_running.load()) return;
+    g_fd = fd;
+    g_running.store(true, std::memory_order_release);
+    if(pthread_create(&g_flusher, NULL, flusher, NULL) != 0) g_running.store(false);
+}
+
+
+void log_shutdown()
+{
+    if(!g_running.exchange(false)) return;
+    pthread_join(g_flusher, NULL);
+    drain();
+    uint64_t dropped = g_dropped.load();
+    if(dropped) LOG_WARN("%lu log messages dropped", (unsigned long)dropped);
+}
+
+
+uint64_t log_dropped()
+{
+    return g_dropped.load(std::memory_order_relaxed);
+}
+
+
+bool log_limiter::allow(uint64_t & reported)
+{
+    uint64_t now = monotonic_ms() / 1000;
+    uint64_t current = window.load(std::memory_order_relaxed);
+    if(current != now && window.compare_exchange_strong(current, now)) count.store(0, std::memory_order_relaxed);
+
+    if(count.fetch_add(1, std::memory_order_relaxed) < LOG_RATE_LIMIT)
+    {
+        reported = suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+    suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
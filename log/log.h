@@ -0,0 +1,74 @@
+#ifndef LOG_H
+#define LOG_H
+
+/*
+    异步日志：
+    1.每个线程一个单生产者单消费者的环形缓冲区，写日志只是格式化到环中的一条定长记录，不加锁、不进内核；
+    2.后台刷写线程轮询所有线程的环，批量格式化时间戳后一次write输出，环满时丢弃并计数；
+    3.级别在编译期过滤：低于LOG_LEVEL的宏展开为常量false分支，参数不会被求值，没有任何开销；
+    4.LOG_ERROR按调用点限速，每秒最多LOG_RATE_LIMIT条，被抑制的条数在下一条放行的日志中报告。
+    log_init()之前或log_shutdown()之后的日志直接同步写出。
+*/
+
+#include <stdint.h>
+#include <atomic>
+
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+
+/* 编译时以-DLOG_LEVEL=LOG_LEVEL_DEBUG打开调试日志 */
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RATE_LIMIT 10
+
+
+/* 启动刷写线程，日志写到fd */
+void log_init(int fd = 1);
+
+/* 写出所有线程中剩余的日志并结束刷写线程 */
+void log_shutdown();
+
+/* 格式化一条日志放入当前线程的环 */
+void log_write(int level, const char * format, ...) __attribute__((format(printf, 2, 3)));
+
+/* 环满被丢弃的日志条数 */
+uint64_t log_dropped();
+
+
+/* 调用点的限速状态，按秒计数 */
+struct log_limiter
+{
+    std::atomic<uint64_t> window;           //当前计数的秒
+    std::atomic<int> count;                 //这一秒已放行的条数
+    std::atomic<uint64_t> suppressed;       //被抑制、还未报告的条数
+
+    /* 放行时返回true，并通过suppressed返回之前被抑制的条数 */
+    bool allow(uint64_t & suppressed);
+};
+
+
+#define LOG_AT(level, format, ...) \
+    do { if((level) >= LOG_LEVEL) log_write(level, format, ##__VA_ARGS__); } while(0)
+
+#define LOG_DEBUG(format, ...) LOG_AT(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#define LOG_INFO(format, ...)  LOG_AT(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define LOG_WARN(format, ...)  LOG_AT(LOG_LEVEL_WARN, format, ##__VA_ARGS__)
+
+#define LOG_ERROR(format, ...) \
+    do { \
+        static log_limiter _limiter; \
+        uint64_t _suppressed; \
+        if(_limiter.allow(_suppressed)) \
+        { \
+            if(_suppressed) log_write(LOG_LEVEL_ERROR, "%lu similar messages suppressed", (unsigned long)_suppressed); \
+            log_write(LOG_LEVEL_ERROR, format, ##__VA_ARGS__); \
+        } \
+    } while(0)
+
+
+#endif
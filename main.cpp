@@ -7,42 +7,30 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <signal.h>
 #include <cassert>
-#include <sys/epoll.h>
+#include <pthread.h>
 
-#include "timer/timer.h"
+#include "config/config.h"
+#include "timer/timer_wheel.h"
 #include "threadpool/locker.h"
 #include "threadpool/threadpool.h"
 #include "http_conn/http_conn.h"
-
-#define MAX_FD 65536
-#define MAX_EVENT_NUMBER 10000
-#define FD_LIMIT 65535
-#define TIMESLOT 5
+#include "reactor/reactor.h"
+#include "reactor/uring_reactor.h"
+#include "log/log.h"
+#include "metrics/metrics.h"
 
 static int pipefd[2];
-static int epollfd = 0;
-static client_data * clientUsers = NULL;
-static time_heap * timer_heap = new time_heap(10);          //创建时间堆存放定时任务
 
 extern int setnoblocking(int fd);
-extern int removefd(int epollfd, int fd);
-extern int addfd(int epollfd, int fd, bool one_shot);
 
-/* 定时器回调函数，删除非活动连接socket的注册事件，并关闭它 */
-void cb_func(client_data* user_data)
-{
-    epoll_ctl(epollfd, EPOLL_CTL_DEL, user_data->sockfd, 0);
-    assert(user_data);
-    close(user_data->sockfd);
-    printf("close fd %d\n", user_data->sockfd);
-}
 
 void sig_handler(int sig)
 {
     int save_errno = errno;
     int msg = sig;
-    int sendBytes = send(pipefd[1], (char*)&msg, 1, 0);
+    send(pipefd[1], (char*)&msg, 1, 0);
     errno = save_errno;
 }
 
@@ -56,169 +44,166 @@ void addsig(int sig, void(handler)(int), bool restart = true)
     assert(sigaction(sig, &sa, NULL) != -1);
 }
 
-void show_error(int connfd, const char* info)
-{
-    printf("%s", info);
-    send(connfd, info, strlen(info), 0);
-    close(connfd);
-}
-
-/*******************定时器相关函数**********************/
-void setTimer(int connfd, sockaddr_in& client_address)
-{
-    clientUsers[connfd].address = client_address;
-    clientUsers[connfd].sockfd = connfd;
-
-    /* 创建定时器。设置回调函数与超时时间，然后绑定定时器与用户数据，最后加入时间堆 */
-    heap_timer* timer = new heap_timer;
-    timer->user_data = &clientUsers[connfd];
-    timer->cb_func = cb_func;
-    time_t cur = time(NULL);
-    timer->expire = cur + 3 * TIMESLOT;
-    printf("THE init: this conn expire= %ld, now cur= %ld\n", timer->expire, cur);
-    clientUsers[connfd].timer = timer;
-    timer_heap->add_timer(timer);
-}
-
-void dealTimerSIG()
+/* 创建监听socket，reuseport为true时设置SO_REUSEPORT，使多个reactor各自监听同一端口并由内核做负载均衡 */
+int open_listenfd(const char* ip, int port, bool reuseport)
 {
-    int sig;
-    char signals[1024];
-    int ret = recv(pipefd[0], signals, sizeof(signals), 0);
-    if(ret == -1) return;
-    else if(ret == 0) return;
-    else
+    int listenfd = socket(PF_INET, SOCK_STREAM, 0);
+    if(listenfd < 0) return -1;
+    /* 不能设置SO_LINGER为{1, 0}：连接会继承该选项，close时直接发RST并丢弃发送缓冲区中尚未发出的响应数据 */
+    if(reuseport)
     {
-        for(int i = 0; i < ret; i++)
-        {
-            switch(signals[i])
-            {
-                case SIGALRM:
-                {
-                    timer_heap->tick();
-                    alarm(TIMESLOT);
-                    break;
-                }
-                case SIGTERM:
-                {
-                    /*TODO*/
-                }
-            }
-        }
+        int on = 1;
+        setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
     }
-}
-
-void adjustTimer(int sockfd)
-{
-    heap_timer* timer = clientUsers[sockfd].timer;
-    time_t cur = time(NULL);
-    timer->expire = cur + 3 * TIMESLOT;
-    printf("adjust timer once\n");
 
+    struct sockaddr_in address;
+    bzero(&address, sizeof(address));
+    address.sin_family = AF_INET;
+    inet_pton(AF_INET, ip, &address.sin_addr);
+    address.sin_port = htons(port);
+    if(bind(listenfd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listenfd, 5) < 0)
+    {
+        LOG_ERROR("bind/listen failure, errno is : %d", errno);
+        close(listenfd);
+        return -1;
+    }
+    return listenfd;
 }
 
 
 int main(int argc, char * argv[])
 {
-    /* 初始化服务器socket */
-    const char* ip = argv[1];
-    int port = atoi(argv[2]);
-    int listenfd = socket(PF_INET, SOCK_STREAM, 0);
-    struct linger tmp = {1, 0};
-    setsockopt(listenfd, SOL_SOCKET, SO_LINGER, &tmp, sizeof(tmp));
+    server_config config;
+    if(!parse_config(argc, argv, config)) return 1;
+
+    /* 异步日志，退出时(包括出错提前返回)写出剩余的日志 */
+    log_init();
+    atexit(log_shutdown);
+
+    /* 指标地址在创建工作线程之前设置，之后只读 */
+    metrics::init(config.metrics_url);
 
-    int ret = 0;
-    struct sockaddr_in address;
-    bzero(&address, sizeof(address));
-    address.sin_family = AF_INET;
-    inet_pton(AF_INET, ip, &address.sin_addr);
-    address.sin_port = htons(port);
-    ret = bind(listenfd, (struct sockaddr*)&address, sizeof(address));
-    ret = listen(listenfd, 5);
-    
     /*
     SIGPIPE:如果socket在接收到了RST之后，程序仍然向这个socket写入数据就会产生SIGPIPE信号,默认情况下这个信号会终止整个进程
     SIG_IGN:忽略信号的处理程序
     */
     addsig(SIGPIPE, SIG_IGN);
 
-    /* 创建线程池和http连接数组httpUsers */
-    threadpool<http_conn>* pool = NULL;
-    try
+    /* 按fd索引的连接表，连接对象在accept时才分配，由各reactor分片使用 */
+    conn_table* table = new conn_table(conn_table::fd_limit(config.max_fd));
+    LOG_INFO("max fd %d", table->max_fd());
+    http_conn::m_sendfile_threshold = config.sendfile_threshold;
+    http_conn::m_header_limit = config.header_limit;
+    http_conn::m_file_cache = new file_cache(config.cached_files, config.revalidate_interval, config.sendfile_threshold);
+    if(config.response_cache > 0)
     {
-        pool = new threadpool<http_conn>;
+        /* 只缓存从映射发送的小文件，更大的文件仍由sendfile发送 */
+        http_conn::m_response_cache = new response_cache(config.response_cache, config.sendfile_threshold, config.revalidate_interval);
+        if(config.gzip_level > 0) http_conn::m_compressor = new compressor(http_conn::m_response_cache, config.gzip_level);
     }
-    catch(...)
+
+    if(config.access_log && !access_log::open(config.access_log))
     {
+        LOG_ERROR("cannot use access log directory %s", config.access_log);
         return 1;
     }
 
-    http_conn* httpUsers = new http_conn[MAX_FD];
-    assert(httpUsers);
-    int user_cont = 0;
-
-    /* 创建epoll对象 */
-    epoll_event events[MAX_EVENT_NUMBER];
-    epollfd  = epoll_create(5);
-    addfd(epollfd, listenfd, false);
-    http_conn::m_epollfd = epollfd;
-
-    /* 设置定时信号传输管道，添加SIGALRM信号，创建客户端信息数组clientUsers */
-    ret = socketpair(PF_UNIX, SOCK_STREAM, 0, pipefd);
+    /* 设置信号传输管道 */
+    int ret = socketpair(PF_UNIX, SOCK_STREAM, 0, pipefd);
     assert(ret != -1);
     setnoblocking(pipefd[1]);
-    addfd(epollfd, pipefd[0], false);
-    addsig(SIGALRM, sig_handler);
     addsig(SIGTERM, sig_handler);
-    clientUsers= new client_data[FD_LIMIT];
-    alarm(TIMESLOT);
 
-    while(true)
+    if(config.uring && !uring::supported())
+    {
+        LOG_WARN("io_uring is not supported, fall back to epoll");
+        config.uring = false;
+    }
+
+    if(config.reactor_number == 0 && !config.uring)
     {
-        int number = epoll_wait(epollfd, events, MAX_EVENT_NUMBER, -1);
-        if(number < 0 && errno != EINTR)
+        /* 单反应堆模式：主线程负责IO，线程池负责处理请求 */
+        threadpool<http_conn>* pool = NULL;
+        try
         {
-            printf("epoll failure\n");
-            break;
+            pool = new threadpool<http_conn>(config.thread_number, 10000, config.work_stealing);
         }
-        for(int i = 0; i < number; i++)
+        catch(...)
         {
-            int sockfd = events[i].data.fd;
-            if(sockfd == listenfd)
-            {
-                struct sockaddr_in client_address;
-                socklen_t client_address_len = sizeof(client_address);
-                int connfd = accept(listenfd, (struct sockaddr*)&client_address, &client_address_len);
-                if(connfd < 0)
-                {
-                    printf("errno is : %d\n", errno);
-                    continue;
-                }
-                if(http_conn::m_user_count >= MAX_FD)
-                {
-                    show_error(connfd, "Internal Server Busy");
-                    continue;
-                }
-                httpUsers[connfd].init(connfd, client_address);
-                setTimer(connfd, client_address);
-            }
-            else if(events[i].events & (EPOLLRDHUP | EPOLLHUP |EPOLLERR)) httpUsers[sockfd].close_conn();
-            else if(events[i].events & EPOLLIN)
+            return 1;
+        }
+
+        int listenfd = open_listenfd(config.ip, config.port, false);
+        if(listenfd < 0) return 1;
+
+        reactor* main_reactor = new reactor(listenfd, table, pool, config, pipefd[0]);
+        main_reactor->loop();
+
+        delete main_reactor;
+        close(listenfd);
+        delete pool;
+    }
+    else
+    {
+        /* 多反应堆模式(epoll或io_uring)：每个线程一个事件循环，各自拥有SO_REUSEPORT监听socket，主线程只等待退出信号 */
+        int n = config.reactor_number > 0 ? config.reactor_number : 1;
+        int* listenfds = new int[n];
+        event_loop** reactors = new event_loop*[n];
+        pthread_t* threads = new pthread_t[n];
+        for(int i = 0; i < n; i++)
+        {
+            listenfds[i] = open_listenfd(config.ip, config.port, true);
+            if(listenfds[i] < 0) return 1;
+            try
             {
-                if(sockfd == pipefd[0]) dealTimerSIG();
-                if(httpUsers[sockfd].read()) pool->append(httpUsers + sockfd), adjustTimer(sockfd);
-                else httpUsers[sockfd].close_conn();
+                if(config.uring) reactors[i] = new uring_reactor(listenfds[i], table, config);
+                else reactors[i] = new reactor(listenfds[i], table, NULL, config);
             }
-            else if(events[i].events & EPOLLOUT)
+            catch(...)
             {
-                if(!httpUsers[sockfd].write()) httpUsers[sockfd].close_conn();
+                return 1;
             }
-            else {}
+            if(pthread_create(threads + i, NULL, event_loop::worker, reactors[i]) != 0) return 1;
+            LOG_INFO("create the %dth reactor", i);
+        }
+
+        char signals[1024];
+        bool stop_server = false;
+        while(!stop_server)
+        {
+            ret = recv(pipefd[0], signals, sizeof(signals), 0);
+            if(ret < 0 && errno == EINTR) continue;
+            if(ret <= 0) break;
+            for(int i = 0; i < ret; i++) if(signals[i] == SIGTERM) stop_server = true;
         }
+
+        for(int i = 0; i < n; i++) reactors[i]->stop();
+        for(int i = 0; i < n; i++)
+        {
+            pthread_join(threads[i], NULL);
+            delete reactors[i];
+            close(listenfds[i]);
+        }
+        delete [] threads;
+        delete [] reactors;
+        delete [] listenfds;
+    }
+
+    close(pipefd[0]);
+    close(pipefd[1]);
+    delete table;
+    if(http_conn::m_compressor)
+    {
+        LOG_INFO("compressor: %lu compressed, %lu dropped", http_conn::m_compressor->compressed(), http_conn::m_compressor->dropped());
+        delete http_conn::m_compressor;
     }
-    close(epollfd);
-    close(listenfd);
-    delete [] httpUsers;
-    delete pool;
+    if(http_conn::m_response_cache)
+    {
+        response_cache::stats st = http_conn::m_response_cache->get_stats();
+        LOG_INFO("response cache: %lu hits, %lu misses, %lu insertions, %lu evictions, %lu entries, %lu bytes",
+               st.hits, st.misses, st.insertions, st.evictions, st.entries, st.bytes);
+        delete http_conn::m_response_cache;
+    }
+    delete http_conn::m_file_cache;
     return 0;
-}
\ No newline at end of file
+}
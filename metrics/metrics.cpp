@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <algorithm>
+
+#include "metrics.h"
+#include "../http_conn/http_conn.h"
+#include "../buffer/buffer_pool.h"
+
+
+const char * metrics::m_url = NULL;
+size_t metrics::m_url_len = 0;
+std::atomic<metrics::shard *> metrics::m_shards(NULL);
+
+static const char * const STAGE_NAMES[STAGE_COUNT] = { "accept_read", "queue_wait", "parse", "request", "write" };
+
+
+metrics::shard::shard() : next(NULL)
+{
+    for(int i = 0; i < CNT_COUNT; i++) counters[i].store(0, std::memory_order_relaxed);
+    for(int i = 0; i < GAUGE_COUNT; i++) gauges[i].store(0, std::memory_order_relaxed);
+    for(int i = 0; i < STAGE_COUNT; i++)
+    {
+        sums[i].store(0, std::memory_order_relaxed);
+        for(int j = 0; j < BUCKETS; j++) buckets[i][j].store(0, std::memory_order_relaxed);
+    }
+}
+
+
+void metrics::init(const char * url)
+{
+    m_url = url;
+    m_url_len = url ? strlen(url) : 0;
+}
+
+
+bool metrics::match(const char * url)
+{
+    if(!m_url || strncmp(url, m_url, m_url_len) != 0) return false;
+    return url[m_url_len] == '\0' || url[m_url_len] == '?';
+}
+
+
+/* 本线程的分片，第一次使用时无锁地插入链表表头 */
+metrics::shard * metrics::local()
+{
+    static thread_local shard * t_shard = NULL;
+    if(t_shard) return t_shard;
+    shard * s = new shard;
+    shard * head = m_shards.load(std::memory_order_relaxed);
+    do
+    {
+        s->next = head;
+    } while(!m_shards.compare_exchange_weak(head, s, std::memory_order_release, std::memory_order_relaxed));
+    t_shard = s;
+    return s;
+}
+
+
+void metrics::add(METRIC_COUNTER counter, uint64_t n)
+{
+    if(!m_url) return;
+    bump(local()->counters[counter], n);
+}
+
+
+void metrics::gauge_add(METRIC_GAUGE gauge, int64_t delta)
+{
+    if(!m_url) return;
+    std::atomic<int64_t> & value = local()->gauges[gauge];
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+
+void metrics::gauge_set(METRIC_GAUGE gauge, int64_t v)
+{
+    if(!m_url) return;
+    local()->gauges[gauge].store(v, std::memory_order_relaxed);
+}
+
+
+void metrics::record(METRIC_STAGE stage, uint64_t us)
+{
+    if(!m_url) return;
+    shard * s = local();
+    bump(s->sums[stage], us);
+    bump(s->buckets[stage][bucket(us)], 1);
+}
+
+
+/* 小于2^SUB_BITS的值每个值一个桶；之后[2^e, 2^(e+1))按最高位以下的SUB_BITS位线性细分 */
+int metrics::bucket(uint64_t us)
+{
+    if(us < (1u << SUB_BITS)) return (int)us;
+    int e = 63 - __builtin_clzll(us);
+    if(e > MAX_EXPONENT) return BUCKETS - 1;
+    int sub = (int)(us >> (e - SUB_BITS)) & ((1 << SUB_BITS) - 1);
+    return ((e - SUB_BITS + 1) << SUB_BITS) | sub;
+}
+
+
+uint64_t metrics::bucket_limit(int index)
+{
+    if(index < (1 << SUB_BITS)) return index + 1;
+    int e = (index >> SUB_BITS) + SUB_BITS - 1;
+    uint64_t sub = index & ((1 << SUB_BITS) - 1);
+    return ((1ull << SUB_BITS) + sub + 1) << (e - SUB_BITS);
+}
+
+
+static void append(std::string & out, const char * format, ...) __attribute__((format(printf, 2, 3)));
+
+static void append(std::string & out, const char * format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if(len > 0) out.append(line, std::min(len, (int)sizeof(line) - 1));
+}
+
+
+static void metric_head(std::string & out, const char * name, const char * type, const char * help)
+{
+    append(out, "# HELP httpserver_%s %s\n# TYPE httpserver_%s %s\n", name, help, name, type);
+}
+
+
+/* 从细分桶中找第q分位所在的桶，取其上界，与HdrHistogram的highestEquivalentValue一致 */
+static double quantile(const uint64_t * buckets, uint64_t count, double q)
+{
+    if(count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * count + 0.5);
+    if(rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for(int i = 0; i < metrics::BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if(seen >= rank) return metrics::bucket_limit(i) / 1e6;
+    }
+    return metrics::bucket_limit(metrics::BUCKETS - 1) / 1e6;
+}
+
+
+void metrics::render(std::string & out)
+{
+    uint64_t counters[CNT_COUNT] = {};
+    int64_t gauges[GAUGE_COUNT] = {};
+    uint64_t sums[STAGE_COUNT] = {};
+    static thread_local uint64_t buckets[STAGE_COUNT][BUCKETS];
+    memset(buckets, 0, sizeof(buckets));
+
+    for(shard * s = m_shards.load(std::memory_order_acquire); s; s = s->next)
+    {
+        for(int i = 0; i < CNT_COUNT; i++) counters[i] += s->counters[i].load(std::memory_order_relaxed);
+        for(int i = 0; i < GAUGE_COUNT; i++) gauges[i] += s->gauges[i].load(std::memory_order_relaxed);
+        for(int i = 0; i < STAGE_COUNT; i++)
+        {
+            sums[i] += s->sums[i].load(std::memory_order_relaxed);
+            for(int j = 0; j < BUCKETS; j++) buckets[i][j] += s->buckets[i][j].load(std::memory_order_relaxed);
+        }
+    }
+    /* 增减发生在不同线程的量规，快照可能短暂为负 */
+    for(int i = 0; i < GAUGE_COUNT; i++) if(gauges[i] < 0) gauges[i] = 0;
+
+    metric_head(out, "connections", "gauge", "Open client connections.");
+    append(out, "httpserver_connections %d\n", http_conn::m_user_count.load(std::memory_order_relaxed));
+    metric_head(out, "idle_connections", "gauge", "Keep-alive connections waiting for the next request.");
+    append(out, "httpserver_idle_connections %ld\n", (long)gauges[GAUGE_IDLE_CONNECTIONS]);
+    metric_head(out, "connections_accepted_total", "counter", "Accepted connections.");
+    append(out, "httpserver_connections_accepted_total %lu\n", (unsigned long)counters[CNT_ACCEPTED]);
+    metric_head(out, "connections_closed_total", "counter", "Closed connections.");
+    append(out, "httpserver_connections_closed_total %lu\n", (unsigned long)counters[CNT_CLOSED]);
+
+    metric_head(out, "responses_total", "counter", "Responses by status class.");
+    const char * classes[] = { "2xx", "3xx", "4xx", "5xx" };
+    for(int i = 0; i < 4; i++) append(out, "httpserver_responses_total{code=\"%s\"} %lu\n", classes[i], (unsigned long)counters[CNT_STATUS_2XX + i]);
+
+    metric_head(out, "queue_depth", "gauge", "Tasks waiting in the thread pool queue.");
+    append(out, "httpserver_queue_depth %ld\n", (long)gauges[GAUGE_QUEUE_DEPTH]);
+    metric_head(out, "queue_rejected_total", "counter", "Tasks dropped because the thread pool queue was full.");
+    append(out, "httpserver_queue_rejected_total %lu\n", (unsigned long)counters[CNT_QUEUE_REJECTED]);
+    metric_head(out, "timers", "gauge", "Pending connection timers.");
+    append(out, "httpserver_timers %ld\n", (long)gauges[GAUGE_TIMERS]);
+
+    metric_head(out, "file_cache_requests_total", "counter", "Open-file cache lookups.");
+    append(out, "httpserver_file_cache_requests_total{result=\"hit\"} %lu\n", (unsigned long)counters[CNT_FILE_CACHE_HITS]);
+    append(out, "httpserver_file_cache_requests_total{result=\"miss\"} %lu\n", (unsigned long)counters[CNT_FILE_CACHE_MISSES]);
+    if(http_conn::m_response_cache)
+    {
+        response_cache::stats st = http_conn::m_response_cache->get_stats();
+        metric_head(out, "response_cache_requests_total", "counter", "Response cache lookups.");
+        append(out, "httpserver_response_cache_requests_total{result=\"hit\"} %lu\n", (unsigned long)st.hits);
+        append(out, "httpserver_response_cache_requests_total{result=\"miss\"} %lu\n", (unsigned long)st.misses);
+        metric_head(out, "response_cache_evictions_total", "counter", "Response cache evictions.");
+        append(out, "httpserver_response_cache_evictions_total %lu\n", (unsigned long)st.evictions);
+        metric_head(out, "response_cache_bytes", "gauge", "Bytes held by the response cache.");
+        append(out, "httpserver_response_cache_bytes %lu\n", (unsigned long)st.bytes);
+        metric_head(out, "response_cache_entries", "gauge", "Entries in the response cache.");
+        append(out, "httpserver_response_cache_entries %lu\n", (unsigned long)st.entries);
+    }
+
+    metric_head(out, "read_buffers_in_use", "gauge", "Read buffers held by connections.");
+    append(out, "httpserver_read_buffers_in_use{size=\"small\"} %ld\n", buffer_pool::in_use(buffer_pool::SMALL_SIZE));
+    append(out, "httpserver_read_buffers_in_use{size=\"large\"} %ld\n", buffer_pool::in_use(buffer_pool::LARGE_SIZE));
+    metric_head(out, "arena_bytes_total", "counter", "Bytes allocated from request arenas.");
+    append(out, "httpserver_arena_bytes_total %lu\n", (unsigned long)counters[CNT_ARENA_BYTES]);
+    metric_head(out, "arena_heap_allocations_total", "counter", "Request arena allocations that fell back to malloc.");
+    append(out, "httpserver_arena_heap_allocations_total %lu\n", (unsigned long)counters[CNT_ARENA_HEAP_ALLOCATIONS]);
+
+    /* 计时截断到微秒，小于2^k微秒的计数就是真实耗时小于2^k微秒的计数 */
+    metric_head(out, "stage_duration_seconds", "histogram", "Time spent in each request stage.");
+    for(int i = 0; i < STAGE_COUNT; i++)
+    {
+        uint64_t cumulative = 0;
+        int next = 0;
+        for(int e = 0; e <= MAX_EXPONENT + 1; e++)
+        {
+            uint64_t limit = 1ull << e;
+            for(; next < BUCKETS - 1 && bucket_limit(next) <= limit; next++) cumulative += buckets[i][next];
+            append(out, "httpserver_stage_duration_seconds_bucket{stage=\"%s\",le=\"%g\"} %lu\n", STAGE_NAMES[i], limit / 1e6, (unsigned long)cumulative);
+        }
+        cumulative += buckets[i][BUCKETS - 1];
+        append(out, "httpserver_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %lu\n", STAGE_NAMES[i], (unsigned long)cumulative);
+        append(out, "httpserver_stage_duration_seconds_sum{stage=\"%s\"} %g\n", STAGE_NAMES[i], sums[i] / 1e6);
+        append(out, "httpserver_stage_duration_seconds_count{stage=\"%s\"} %lu\n", STAGE_NAMES[i], (unsigned long)cumulative);
+    }
+
+    metric_head(out, "stage_duration_quantile_seconds", "gauge", "Stage latency quantiles from the full-resolution histogram.");
+    const double quantiles[] = { 0.5, 0.99, 0.999 };
+    for(int i = 0; i < STAGE_COUNT; i++)
+    {
+        uint64_t count = 0;
+        for(int j = 0; j < BUCKETS; j++) count += buckets[i][j];
+        for(double q : quantiles)
+            append(out, "httpserver_stage_duration_quantile_seconds{stage=\"%s\",quantile=\"%g\"} %g\n", STAGE_NAMES[i], q, quantile(buckets[i], count, q));
+    }
+}
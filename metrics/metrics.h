@@ -0,0 +1,103 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/*
+    运行时指标：
+    1.每个线程一个分片，计数器、量规和延迟直方图只由所属线程写入，更新是relaxed的load+store，没有锁和原子读改写；
+    2.分片在线程第一次记录时用CAS挂到全局链表的表头，之后一直保留，线程退出后它的计数仍然计入总数；
+    3.导出时遍历链表把各分片相加，不阻塞任何写入方，得到的是近似一致的快照；
+    4.延迟直方图与HdrHistogram相同：按2的幂分段，每段再线性分成8个子桶，相对误差不超过12.5%。
+      导出为Prometheus文本格式，累积桶取2的幂的边界，另外给出由细分桶计算的p50、p99、p999。
+    只有设置了URL(-m)时才记录，否则每个记录函数只检查一个标志，请求路径上不读时钟。
+*/
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+
+
+/* 请求各阶段的耗时，单位微秒 */
+enum METRIC_STAGE
+{
+    STAGE_ACCEPT_READ = 0,          //accept到第一次读到数据
+    STAGE_QUEUE_WAIT,               //在线程池队列中等待
+    STAGE_PARSE,                    //解析请求行和头部(请求完整的那一次process_read)
+    STAGE_REQUEST,                  //do_request
+    STAGE_WRITE,                    //一批响应排入输出链到全部发送完毕
+    STAGE_COUNT
+};
+
+
+enum METRIC_COUNTER
+{
+    CNT_ACCEPTED = 0,
+    CNT_CLOSED,
+    CNT_STATUS_2XX,
+    CNT_STATUS_3XX,
+    CNT_STATUS_4XX,
+    CNT_STATUS_5XX,
+    CNT_QUEUE_REJECTED,             //线程池队列已满，任务没有入队
+    CNT_FILE_CACHE_HITS,
+    CNT_FILE_CACHE_MISSES,          //加载或因文件变化重新加载
+    CNT_ARENA_BYTES,                //请求级内存池分配的字节数
+    CNT_ARENA_HEAP_ALLOCATIONS,     //请求级内存池超出大块而malloc的次数
+    CNT_COUNT
+};
+
+
+/* 各分片的值相加得到总数：增减可以发生在不同线程，各自记在自己的分片上 */
+enum METRIC_GAUGE
+{
+    GAUGE_QUEUE_DEPTH = 0,          //线程池队列中的任务数，入队线程加一、出队线程减一
+    GAUGE_IDLE_CONNECTIONS,         //长连接上一批响应已发送完毕、等待下一个请求的连接数
+    GAUGE_TIMERS,                   //时间轮上的定时器数，每个事件循环设置自己分片的值
+    GAUGE_COUNT
+};
+
+
+class metrics
+{
+    public:
+        static const int SUB_BITS = 3;                                  //每个2的幂分成2^SUB_BITS个子桶
+        static const int MAX_EXPONENT = 31;                             //超过2^32微秒(约71分钟)的值计入最后一个桶
+        static const int BUCKETS = (MAX_EXPONENT - SUB_BITS + 2) << SUB_BITS;
+
+        /* url为NULL时不记录、不导出，在创建任何线程之前调用 */
+        static void init(const char * url);
+        static bool enabled() { return m_url != NULL; }
+        static bool match(const char * url);                            //请求的URL是否为指标地址，忽略查询字符串
+
+        static void add(METRIC_COUNTER counter, uint64_t n = 1);
+        static void gauge_add(METRIC_GAUGE gauge, int64_t delta);
+        static void gauge_set(METRIC_GAUGE gauge, int64_t value);      //只设置本线程分片的值
+        static void record(METRIC_STAGE stage, uint64_t us);
+
+        /* 汇总所有分片，以Prometheus文本格式追加到out */
+        static void render(std::string & out);
+
+        /* 直方图的桶下标与每个桶的上界(不含) */
+        static int bucket(uint64_t us);
+        static uint64_t bucket_limit(int index);
+
+    private:
+        struct shard
+        {
+            std::atomic<uint64_t> counters[CNT_COUNT];
+            std::atomic<int64_t> gauges[GAUGE_COUNT];
+            std::atomic<uint64_t> sums[STAGE_COUNT];
+            std::atomic<uint64_t> buckets[STAGE_COUNT][BUCKETS];
+            shard * next;
+
+            shard();
+        };
+
+        static shard * local();
+        static void bump(std::atomic<uint64_t> & value, uint64_t n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+        static const char * m_url;
+        static size_t m_url_len;
+        static std::atomic<shard *> m_shards;
+};
+
+
+#endif
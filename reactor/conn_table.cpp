@@ -0,0 +1,81 @@
+#include <new>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include "conn_table.h"
+
+
+conn_table::conn_table(int max_fd) : m_max_fd(max_fd), m_slab(NULL), m_slab_left(0)
+{
+    m_page_count = (max_fd + PAGE_SIZE - 1) >> PAGE_BITS;
+    m_pages = new std::atomic<page *>[m_page_count];
+    for(int i = 0; i < m_page_count; i++) m_pages[i].store(NULL, std::memory_order_relaxed);
+}
+
+
+conn_table::~conn_table()
+{
+    for(size_t i = 0; i < m_objects.size(); i++) m_objects[i]->~connection();
+    for(size_t i = 0; i < m_slabs.size(); i++) free(m_slabs[i]);
+    for(int i = 0; i < m_page_count; i++) delete m_pages[i].load(std::memory_order_relaxed);
+    delete [] m_pages;
+}
+
+
+connection * conn_table::acquire(int fd)
+{
+    if(fd < 0 || fd >= m_max_fd) return NULL;
+    connection * conn = get(fd);
+    if(conn) return conn;
+
+    m_lock.lock();
+    page * p = m_pages[fd >> PAGE_BITS].load(std::memory_order_relaxed);
+    if(!p)
+    {
+        p = new (std::nothrow) page;
+        if(!p)
+        {
+            m_lock.unlock();
+            return NULL;
+        }
+        for(int i = 0; i < PAGE_SIZE; i++) p->slots[i].store(NULL, std::memory_order_relaxed);
+        m_pages[fd >> PAGE_BITS].store(p, std::memory_order_release);
+    }
+
+    conn = p->slots[fd & (PAGE_SIZE - 1)].load(std::memory_order_relaxed);
+    if(!conn)
+    {
+        if(m_slab_left == 0)
+        {
+            m_slab = (connection *)aligned_alloc(64, ((sizeof(connection) * SLAB_SIZE) + 63) & ~(size_t)63);
+            if(!m_slab)
+            {
+                m_lock.unlock();
+                return NULL;
+            }
+            m_slabs.push_back(m_slab);
+            m_slab_left = SLAB_SIZE;
+        }
+        conn = new (m_slab++) connection();
+        m_slab_left--;
+        m_objects.push_back(conn);
+        p->slots[fd & (PAGE_SIZE - 1)].store(conn, std::memory_order_release);
+    }
+    m_lock.unlock();
+    return conn;
+}
+
+
+int conn_table::fd_limit(int configured)
+{
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        if(setrlimit(RLIMIT_NOFILE, &limit) != 0) getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if(configured > 0) return configured;
+    if(getrlimit(RLIMIT_NOFILE, &limit) != 0) return 1024;
+    if(limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur > (1 << 24)) return 1 << 24;
+    return (int)limit.rlim_cur;
+}
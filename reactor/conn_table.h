@@ -0,0 +1,76 @@
+#ifndef CONN_TABLE_H
+#define CONN_TABLE_H
+
+/*
+    按fd索引的连接表：
+    1.连接对象在某个fd号第一次accept时才分配，从每次64个对象的slab中切出，之后该fd号复用同一个对象；
+    2.索引分页，每页256个指针，页在第一次用到时分配，启动时只分配页目录；
+    3.fd上限在启动时由RLIMIT_NOFILE或-n参数决定。
+    对象在表销毁前不会释放：定时器、线程池中的任务都可能在连接关闭后仍持有槽位指针。
+    查找不加锁，分配(accept时)由一把互斥锁保护，多个reactor可以同时accept。
+*/
+
+#include <atomic>
+#include <vector>
+
+#include "../timer/timer_wheel.h"
+#include "../http_conn/http_conn.h"
+#include "../threadpool/locker.h"
+
+
+/* 一个fd的全部状态：定时器和http_conn的热字段在前，http_conn的缓冲区数组在对象末尾 */
+struct connection
+{
+    client_data client;
+    http_conn http;
+};
+
+
+class conn_table
+{
+    public:
+        explicit conn_table(int max_fd);
+        ~conn_table();
+
+        int max_fd() const { return m_max_fd; }
+        connection * get(int fd) const;                 //没有分配过时返回NULL
+        connection * acquire(int fd);                   //accept时调用，fd超出上限或内存不足时返回NULL
+
+        /* 只能用于已经acquire过的fd */
+        http_conn & http(int fd) const { return get(fd)->http; }
+        client_data & client(int fd) const { return get(fd)->client; }
+
+        /* 取RLIMIT_NOFILE的软限制(先尝试提高到硬限制)，configured大于0时以它为准 */
+        static int fd_limit(int configured);
+
+    private:
+        static const int PAGE_BITS = 8;
+        static const int PAGE_SIZE = 1 << PAGE_BITS;
+        static const int SLAB_SIZE = 64;
+
+        struct page
+        {
+            std::atomic<connection *> slots[PAGE_SIZE];
+        };
+
+        int m_max_fd;
+        int m_page_count;
+        std::atomic<page *> * m_pages;
+        locker m_lock;
+        connection * m_slab;                            //当前slab中下一个未使用的对象
+        int m_slab_left;
+        std::vector<connection *> m_slabs;
+        std::vector<connection *> m_objects;            //已构造的对象，析构时逐个析构
+};
+
+
+inline connection * conn_table::get(int fd) const
+{
+    if(fd < 0 || fd >= m_max_fd) return NULL;
+    page * p = m_pages[fd >> PAGE_BITS].load(std::memory_order_acquire);
+    if(!p) return NULL;
+    return p->slots[fd & (PAGE_SIZE - 1)].load(std::memory_order_acquire);
+}
+
+
+#endif
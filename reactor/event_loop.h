@@ -0,0 +1,27 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+/*
+    事件循环接口：
+    epoll反应堆(reactor)和io_uring后端(uring_reactor)都实现该接口，
+    main只通过它在各个线程中启动循环，并在收到SIGTERM后停止它们。
+*/
+
+class event_loop
+{
+    public:
+        virtual ~event_loop() {}
+        virtual void loop() = 0;                    //事件循环，stop()之后返回
+        virtual void stop() = 0;                    //可在其他线程调用
+
+        /* 线程入口 */
+        static void * worker(void * arg)
+        {
+            event_loop * l = (event_loop *) arg;
+            l->loop();
+            return l;
+        }
+};
+
+
+#endif
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cassert>
+#include <arpa/inet.h>
+#include <sys/eventfd.h>
+
+#include "reactor.h"
+#include "../timer/clock.h"
+#include "../log/log.h"
+#include "../metrics/metrics.h"
+
+extern int setnoblocking(int fd);
+extern void addfd(int epollfd, int fd, bool one_shot);
+
+conn_table * reactor::m_table = NULL;
+
+
+static void show_error(int connfd, const char* info)
+{
+    LOG_WARN("%s", info);
+    send(connfd, info, strlen(info), 0);
+    close(connfd);
+}
+
+
+reactor::reactor(int listenfd, conn_table * table, threadpool<http_conn> * pool, const server_config & config, int sigfd)
+    : m_listenfd(listenfd), m_sigfd(sigfd), m_stop(false), m_request_timeout(config.request_timeout), m_keepalive_timeout(config.keepalive_timeout), m_pool(pool)
+{
+    m_table = table;
+    m_epollfd = epoll_create(5);
+    if(m_epollfd < 0) throw std::exception();
+    m_wakeupfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(m_wakeupfd < 0)
+    {
+        close(m_epollfd);
+        throw std::exception();
+    }
+
+    addfd(m_epollfd, m_listenfd, false);
+    addfd(m_epollfd, m_wakeupfd, false);
+    if(m_sigfd != -1) addfd(m_epollfd, m_sigfd, false);
+
+    m_now = monotonic_ms();
+    m_timer_wheel = new timer_wheel(m_now);        //每个reactor独占一个时间轮，定时器只在本线程内增删
+}
+
+
+reactor::~reactor()
+{
+    close(m_wakeupfd);
+    close(m_epollfd);
+    delete m_timer_wheel;
+}
+
+
+void reactor::stop()
+{
+    m_stop = true;
+    uint64_t one = 1;
+    ssize_t ret = ::write(m_wakeupfd, &one, sizeof(one));
+    (void)ret;
+}
+
+
+void reactor::loop()
+{
+    /* 定时器由epoll_wait的超时驱动：超时时间取时间轮上最近的到期时间，没有定时器时一直阻塞 */
+    while(!m_stop)
+    {
+        int timeout = m_timer_wheel->next_timeout(m_now);
+        int number = epoll_wait(m_epollfd, m_events, MAX_EVENT_NUMBER, timeout);
+        if(number < 0 && errno != EINTR)
+        {
+            LOG_ERROR("epoll failure, errno is : %d", errno);
+            break;
+        }
+        m_now = monotonic_ms();
+        for(int i = 0; i < number; i++)
+        {
+            int sockfd = m_events[i].data.fd;
+            if(sockfd == m_listenfd) deal_accept();
+            else if(sockfd == m_wakeupfd) deal_wakeup();
+            else if(sockfd == m_sigfd && (m_events[i].events & EPOLLIN)) deal_signal();
+            else if(m_events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) close_conn(sockfd);
+            else if(m_events[i].events & EPOLLIN) deal_read(sockfd);
+            else if(m_events[i].events & EPOLLOUT) deal_write(sockfd);
+            else {}
+        }
+
+        m_timer_wheel->tick(m_now);
+        metrics::gauge_set(GAUGE_TIMERS, m_timer_wheel->size());
+    }
+}
+
+
+void reactor::deal_accept()
+{
+    /* 监听socket注册为ET模式，必须一次accept到EAGAIN为止，否则会漏掉连接 */
+    while(true)
+    {
+        struct sockaddr_in client_address;
+        socklen_t client_address_len = sizeof(client_address);
+        int connfd = accept(m_listenfd, (struct sockaddr*)&client_address, &client_address_len);
+        if(connfd < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK) LOG_ERROR("accept failure, errno is : %d", errno);
+            return;
+        }
+        if(http_conn::m_user_count >= m_table->max_fd() || !m_table->acquire(connfd))
+        {
+            show_error(connfd, "Internal Server Busy");
+            continue;
+        }
+        m_table->http(connfd).init(connfd, client_address, m_epollfd);
+        set_timer(connfd, client_address);
+    }
+}
+
+
+void reactor::deal_read(int sockfd)
+{
+    if(!m_table->http(sockfd).read())
+    {
+        close_conn(sockfd);
+        return;
+    }
+    dispatch(sockfd);
+}
+
+
+/* 处理读缓冲区中的请求：单反应堆模式交给线程池，多反应堆模式在本线程处理 */
+void reactor::dispatch(int sockfd)
+{
+    if(m_pool) m_pool->append(&m_table->http(sockfd));
+    else
+    {
+        /*
+            多反应堆模式下在本线程内直接处理，避免fd跨线程。
+            process()失败时会关闭fd，该fd号随即可能被其他reactor复用，所以先摘下定时器，关闭后不再访问该槽位
+        */
+        m_timer_wheel->del_timer(&m_table->client(sockfd).wtimer);
+        if(!m_table->http(sockfd).process()) return;
+    }
+    adjust_timer(sockfd, m_request_timeout);
+}
+
+
+void reactor::deal_write(int sockfd)
+{
+    if(!m_table->http(sockfd).write())
+    {
+        close_conn(sockfd);
+        return;
+    }
+    /* 响应发送完毕后，先处理上一批留下的流水线请求，没有则进入长连接空闲状态；否则说明还在等待socket可写 */
+    if(m_table->http(sockfd).writing()) adjust_timer(sockfd, m_request_timeout);
+    else if(m_table->http(sockfd).pending_input()) dispatch(sockfd);
+    else adjust_timer(sockfd, m_keepalive_timeout);
+}
+
+
+void reactor::close_conn(int sockfd)
+{
+    m_timer_wheel->del_timer(&m_table->client(sockfd).wtimer);
+    m_table->http(sockfd).close_conn();
+}
+
+
+void reactor::deal_wakeup()
+{
+    uint64_t count;
+    ssize_t ret = ::read(m_wakeupfd, &count, sizeof(count));
+    (void)ret;
+}
+
+
+void reactor::deal_signal()
+{
+    char signals[1024];
+    int ret = recv(m_sigfd, signals, sizeof(signals), 0);
+    if(ret <= 0) return;
+
+    for(int i = 0; i < ret; i++)
+    {
+        switch(signals[i])
+        {
+            case SIGTERM:
+            {
+                m_stop = true;
+                break;
+            }
+        }
+    }
+}
+
+
+/*******************定时器相关函数**********************/
+void reactor::set_timer(int connfd, const sockaddr_in & client_address)
+{
+    client_data & client = m_table->client(connfd);
+    client.address = client_address;
+    client.sockfd = connfd;
+
+    /* 设置定时器的回调函数与超时时间，然后绑定用户数据，最后加入时间轮。定时器嵌在client_data中，fd复用时直接重新挂载 */
+    wheel_timer* timer = &client.wtimer;
+    timer->user_data = &client;
+    timer->cb_func = cb_func;
+    timer->expire = m_now + m_request_timeout;
+    LOG_DEBUG("set timer: fd %d expire= %lu, now cur= %lu", connfd, (unsigned long)timer->expire, (unsigned long)m_now);
+    m_timer_wheel->add_timer(timer);
+}
+
+
+/* 连接有活动时顺延超时时间，只是一次O(1)的链表移动，不会破坏任何不变式 */
+void reactor::adjust_timer(int sockfd, int timeout)
+{
+    m_timer_wheel->mod_timer(&m_table->client(sockfd).wtimer, m_now + timeout);
+    LOG_DEBUG("adjust timer: fd %d", sockfd);
+}
+
+
+/* 定时器回调函数，通过http_conn关闭非活动连接，保证连接计数与fd状态一致 */
+void reactor::cb_func(client_data * user_data)
+{
+    assert(user_data);
+    m_table->http(user_data->sockfd).close_conn();
+    LOG_DEBUG("close fd %d", user_data->sockfd);
+}
@@ -0,0 +1,67 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+/*
+    反应堆模块：
+    每个reactor拥有独立的epoll实例、监听socket和时间轮，负责自己accept到的连接。
+    1.单反应堆模式：与原来的半同步/半反应堆一致，reactor只做IO，process()交给线程池；
+    2.多反应堆模式(one loop per thread)：每个线程运行一个reactor，监听socket使用SO_REUSEPORT由内核分流，
+      读、解析、写都在本线程内完成，fd不会在线程之间传递。
+    fd在进程内唯一，每个reactor只会访问自己accept到的fd对应的连接槽位，因此连接表按fd天然分片，无需加锁。
+*/
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+
+#include "../config/config.h"
+#include "../timer/timer_wheel.h"
+#include "../threadpool/threadpool.h"
+#include "../http_conn/http_conn.h"
+#include "event_loop.h"
+#include "conn_table.h"
+
+#define MAX_EVENT_NUMBER 10000
+
+class reactor : public event_loop
+{
+    public:
+        /* pool为NULL时在本线程内直接处理请求；sigfd为信号管道读端，-1表示不处理信号 */
+        reactor(int listenfd, conn_table * table, threadpool<http_conn> * pool, const server_config & config, int sigfd = -1);
+        ~reactor();
+
+        void loop();                                //事件循环
+        void stop();                                //可在其他线程调用，通过eventfd唤醒epoll_wait
+
+    private:
+        void deal_accept();
+        void deal_read(int sockfd);
+        void dispatch(int sockfd);
+        void deal_write(int sockfd);
+        void deal_signal();
+        void deal_wakeup();
+        void close_conn(int sockfd);                //关闭连接并摘除其定时器
+
+        /* 定时器相关函数 */
+        void set_timer(int connfd, const sockaddr_in & client_address);
+        void adjust_timer(int sockfd, int timeout);
+        static void cb_func(client_data * user_data);
+
+    private:
+        static conn_table * m_table;                //所有reactor共享的按fd索引的连接表
+
+        int m_epollfd;
+        int m_listenfd;
+        int m_sigfd;
+        int m_wakeupfd;                             //eventfd，用于从其他线程唤醒本reactor
+        volatile bool m_stop;
+        uint64_t m_now;                             //缓存的单调时钟(毫秒)，每轮epoll_wait返回后更新
+        int m_request_timeout;                      //等待请求到达及发送响应的超时时间(毫秒)
+        int m_keepalive_timeout;                    //长连接两次请求之间的空闲超时时间(毫秒)
+        threadpool<http_conn> * m_pool;
+        timer_wheel * m_timer_wheel;
+        epoll_event m_events[MAX_EVENT_NUMBER];
+};
+
+
+#endif
@@ -0,0 +1,230 @@
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <exception>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+
+static int io_uring_setup(unsigned entries, io_uring_params * p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void * arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+
+static int io_uring_register(int fd, unsigned opcode, void * arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+
+uring::uring(unsigned entries) : m_ringfd(-1), m_sq_ptr(MAP_FAILED), m_cq_ptr(MAP_FAILED), m_sqes((io_uring_sqe *)MAP_FAILED),
+    m_sq_local_tail(0), m_to_submit(0), m_buf_ring(NULL), m_buf_ring_size(0), m_bufs(NULL), m_buf_count(0), m_buf_size(0)
+{
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    /* SINGLE_ISSUER的提交线程在启用ring时确定，所以先以禁用状态创建，由事件循环线程调用enable() */
+    p.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_R_DISABLED;
+    m_ringfd = io_uring_setup(entries, &p);
+    if(m_ringfd < 0) throw std::exception();
+    if(!(p.features & IORING_FEAT_EXT_ARG))                 //等待时需要直接传入超时时间
+    {
+        close(m_ringfd);
+        throw std::exception();
+    }
+    m_entries = p.sq_entries;
+
+    /* 映射SQ、CQ环和SQE数组，新内核上SQ和CQ共用一次映射 */
+    m_sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    m_cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(m_cq_size > m_sq_size) m_sq_size = m_cq_size;
+        m_cq_size = m_sq_size;
+    }
+    m_sq_ptr = mmap(0, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringfd, IORING_OFF_SQ_RING);
+    if(m_sq_ptr == MAP_FAILED)
+    {
+        close(m_ringfd);
+        throw std::exception();
+    }
+    if(p.features & IORING_FEAT_SINGLE_MMAP) m_cq_ptr = m_sq_ptr;
+    else
+    {
+        m_cq_ptr = mmap(0, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringfd, IORING_OFF_CQ_RING);
+        if(m_cq_ptr == MAP_FAILED)
+        {
+            munmap(m_sq_ptr, m_sq_size);
+            close(m_ringfd);
+            throw std::exception();
+        }
+    }
+    m_sqes = (io_uring_sqe *)mmap(0, p.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringfd, IORING_OFF_SQES);
+    if(m_sqes == MAP_FAILED)
+    {
+        if(m_cq_ptr != m_sq_ptr) munmap(m_cq_ptr, m_cq_size);
+        munmap(m_sq_ptr, m_sq_size);
+        close(m_ringfd);
+        throw std::exception();
+    }
+
+    char * sq = (char *)m_sq_ptr;
+    m_sq_head = (unsigned *)(sq + p.sq_off.head);
+    m_sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    m_sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    m_sq_array = (unsigned *)(sq + p.sq_off.array);
+    m_sq_local_tail = *m_sq_tail;
+
+    char * cq = (char *)m_cq_ptr;
+    m_cq_head = (unsigned *)(cq + p.cq_off.head);
+    m_cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    m_cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    m_cqes = (io_uring_cqe *)(cq + p.cq_off.cqes);
+}
+
+
+uring::~uring()
+{
+    if(m_buf_ring) munmap(m_buf_ring, m_buf_ring_size);
+    delete [] m_bufs;
+    munmap(m_sqes, m_entries * sizeof(io_uring_sqe));
+    if(m_cq_ptr != m_sq_ptr) munmap(m_cq_ptr, m_cq_size);
+    munmap(m_sq_ptr, m_sq_size);
+    close(m_ringfd);
+}
+
+
+io_uring_sqe * uring::get_sqe()
+{
+    unsigned head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+    if(m_sq_local_tail - head >= m_entries)
+    {
+        submit();
+        head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+        if(m_sq_local_tail - head >= m_entries) return NULL;
+    }
+    unsigned index = m_sq_local_tail & *m_sq_mask;
+    io_uring_sqe * sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sq_array[index] = index;
+    m_sq_local_tail++;
+    m_to_submit++;
+    return sqe;
+}
+
+
+bool uring::enable()
+{
+    return io_uring_register(m_ringfd, IORING_REGISTER_ENABLE_RINGS, NULL, 0) == 0;
+}
+
+
+bool uring::reserve(unsigned n)
+{
+    if(m_sq_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) + n <= m_entries) return true;
+    submit();
+    return m_sq_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) + n <= m_entries;
+}
+
+
+int uring::submit()
+{
+    __atomic_store_n(m_sq_tail, m_sq_local_tail, __ATOMIC_RELEASE);
+    if(m_to_submit == 0) return 0;
+    int ret = io_uring_enter(m_ringfd, m_to_submit, 0, 0, NULL, 0);
+    if(ret < 0) return -errno;
+    m_to_submit -= ret;
+    return ret;
+}
+
+
+int uring::submit_and_wait(int timeout_ms)
+{
+    __atomic_store_n(m_sq_tail, m_sq_local_tail, __ATOMIC_RELEASE);
+
+    /* 通过IORING_ENTER_EXT_ARG把超时时间直接交给内核，一次系统调用完成提交和等待 */
+    struct __kernel_timespec ts;
+    io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    if(timeout_ms >= 0)
+    {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+
+    int ret = io_uring_enter(m_ringfd, m_to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if(ret < 0) return -errno;
+    m_to_submit -= ret;
+    return ret;
+}
+
+
+bool uring::register_buffers(uint16_t bgid, unsigned count, unsigned size)
+{
+    if(count == 0 || (count & (count - 1)) != 0 || count > 32768) return false;
+
+    m_buf_ring_size = count * sizeof(io_uring_buf);
+    void * ring = mmap(0, m_buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ring == MAP_FAILED) return false;
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring;
+    reg.ring_entries = count;
+    reg.bgid = bgid;
+    if(io_uring_register(m_ringfd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        munmap(ring, m_buf_ring_size);
+        return false;
+    }
+
+    m_buf_ring = (io_uring_buf_ring *)ring;
+    m_buf_count = count;
+    m_buf_size = size;
+    m_bufs = new char[(size_t)count * size];
+    for(unsigned i = 0; i < count; i++)
+    {
+        io_uring_buf * buf = ring_entry(i);
+        buf->addr = (uint64_t)(uintptr_t)buffer(i);
+        buf->len = size;
+        buf->bid = i;
+    }
+    __atomic_store_n(&m_buf_ring->tail, (uint16_t)count, __ATOMIC_RELEASE);
+    return true;
+}
+
+
+void uring::recycle_buffer(uint16_t bid)
+{
+    uint16_t tail = m_buf_ring->tail;
+    io_uring_buf * buf = ring_entry(tail & (m_buf_count - 1));
+    buf->addr = (uint64_t)(uintptr_t)buffer(bid);
+    buf->len = m_buf_size;
+    buf->bid = bid;
+    __atomic_store_n(&m_buf_ring->tail, (uint16_t)(tail + 1), __ATOMIC_RELEASE);
+}
+
+
+bool uring::supported()
+{
+    try
+    {
+        uring probe(4);
+        return probe.register_buffers(0, 1, 64) && probe.enable();
+    }
+    catch(...)
+    {
+        return false;
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef URING_H
+#define URING_H
+
+/*
+    io_uring的最小封装：
+    直接使用io_uring_setup/io_uring_enter/io_uring_register系统调用，不依赖liburing。
+    只提供本服务器用到的部分：取SQE、提交并等待(带超时)、遍历CQE、注册provided buffer ring。
+    一个uring实例只能在一个线程内使用(IORING_SETUP_SINGLE_ISSUER)。
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+
+class uring
+{
+    public:
+        explicit uring(unsigned entries);       //失败时抛出异常，创建后处于禁用状态
+        ~uring();
+
+        bool enable();                          //启用ring，调用线程成为唯一的提交线程
+
+        io_uring_sqe * get_sqe();               //SQ满时先提交已有的SQE
+        bool reserve(unsigned n);               //保证接下来能连续取到n个SQE，链接的SQE链不能被中途提交拆开
+        int submit();
+        int submit_and_wait(int timeout_ms);    //timeout_ms为-1时一直等待，返回值<0为-errno
+
+        /* 依次处理所有已完成的CQE */
+        template<typename F>
+        void for_each_cqe(F f)
+        {
+            unsigned head = *m_cq_head;
+            unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+            for(; head != tail; head++) f(&m_cqes[head & *m_cq_mask]);
+            __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+        }
+
+        /* 注册provided buffer ring：count个大小为size的缓冲区，count必须是2的幂 */
+        bool register_buffers(uint16_t bgid, unsigned count, unsigned size);
+        char * buffer(uint16_t bid) { return m_bufs + (size_t)bid * m_buf_size; }
+        void recycle_buffer(uint16_t bid);      //缓冲区用完后还给内核
+
+        static bool supported();                //内核是否支持本后端需要的特性
+
+    private:
+        uring(const uring &);
+        uring & operator=(const uring &);
+
+        /* 不能用io_uring_buf_ring::bufs：C++中__DECLARE_FLEX_ARRAY里的空结构体占1字节，bufs会偏移到第8字节 */
+        io_uring_buf * ring_entry(unsigned i) { return (io_uring_buf *)m_buf_ring + i; }
+
+    private:
+        int m_ringfd;
+        unsigned m_entries;
+
+        void * m_sq_ptr;
+        size_t m_sq_size;
+        void * m_cq_ptr;
+        size_t m_cq_size;
+        io_uring_sqe * m_sqes;
+
+        unsigned * m_sq_head;
+        unsigned * m_sq_tail;
+        unsigned * m_sq_mask;
+        unsigned * m_sq_array;
+        unsigned m_sq_local_tail;               //尚未提交的SQE写到这里，提交时才发布给内核
+        unsigned m_to_submit;
+
+        unsigned * m_cq_head;
+        unsigned * m_cq_tail;
+        unsigned * m_cq_mask;
+        io_uring_cqe * m_cqes;
+
+        io_uring_buf_ring * m_buf_ring;
+        size_t m_buf_ring_size;
+        char * m_bufs;
+        unsigned m_buf_count;
+        unsigned m_buf_size;
+};
+
+
+#endif
@@ -0,0 +1,510 @@
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <cassert>
+#include <sys/eventfd.h>
+
+#include "uring_reactor.h"
+#include "../timer/clock.h"
+#include "../log/log.h"
+#include "../metrics/metrics.h"
+
+
+uring_reactor::uring_reactor(int listenfd, conn_table * table, const server_config & config)
+    : m_listenfd(listenfd), m_stop(false), m_request_timeout(config.request_timeout), m_keepalive_timeout(config.keepalive_timeout),
+      m_table(table)
+{
+    m_ring = new uring(RING_ENTRIES);
+    if(!m_ring->register_buffers(BUFFER_GROUP, RECV_BUFFER_COUNT, RECV_BUFFER_SIZE))
+    {
+        delete m_ring;
+        throw std::exception();
+    }
+    m_wakeupfd = eventfd(0, EFD_CLOEXEC);
+    if(m_wakeupfd < 0)
+    {
+        delete m_ring;
+        throw std::exception();
+    }
+
+    m_conns = (conn_state **)calloc(m_table->max_fd(), sizeof(conn_state *));
+    if(!m_conns)
+    {
+        close(m_wakeupfd);
+        delete m_ring;
+        throw std::exception();
+    }
+
+    m_now = monotonic_ms();
+    m_timer_wheel = new timer_wheel(m_now);
+
+    arm_accept();
+    arm_wakeup();
+}
+
+
+uring_reactor::~uring_reactor()
+{
+    delete m_ring;                              //关闭ring时内核取消所有未完成的请求
+    close(m_wakeupfd);
+    for(int i = 0; i < m_table->max_fd(); i++) delete m_conns[i];
+    free(m_conns);
+    delete m_timer_wheel;
+}
+
+
+void uring_reactor::stop()
+{
+    m_stop = true;
+    uint64_t one = 1;
+    ssize_t ret = ::write(m_wakeupfd, &one, sizeof(one));
+    (void)ret;
+}
+
+
+void uring_reactor::loop()
+{
+    if(!m_ring->enable())
+    {
+        LOG_ERROR("io_uring enable failure, errno is : %d", errno);
+        return;
+    }
+
+    /* 提交本轮产生的SQE并等待完成事件，超时时间取时间轮上最近的到期时间 */
+    while(!m_stop)
+    {
+        int timeout = m_timer_wheel->next_timeout(m_now);
+        int ret = m_ring->submit_and_wait(timeout);
+        if(ret < 0 && ret != -ETIME && ret != -EINTR && ret != -EBUSY)
+        {
+            LOG_ERROR("io_uring failure, errno is : %d", -ret);
+            break;
+        }
+        m_now = monotonic_ms();
+        m_ring->for_each_cqe([this](io_uring_cqe * cqe) { handle(cqe); });
+
+        m_timer_wheel->tick(m_now);
+        metrics::gauge_set(GAUGE_TIMERS, m_timer_wheel->size());
+    }
+}
+
+
+void uring_reactor::handle(io_uring_cqe * cqe)
+{
+    int op = (int)(cqe->user_data >> 56);
+    uint32_t gen = (uint32_t)(cqe->user_data >> 32) & 0xffffff;
+    int fd = (int)(uint32_t)cqe->user_data;
+
+    /* 缓冲区无论属于哪个连接都要先还给内核 */
+    if(op == OP_RECV && (cqe->flags & IORING_CQE_F_BUFFER) && cqe->res <= 0)
+        m_ring->recycle_buffer((uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+
+    switch(op)
+    {
+        case OP_ACCEPT: on_accept(cqe); return;
+        case OP_WAKEUP: if(!m_stop) arm_wakeup(); return;
+        case OP_SHUTDOWN: if(cqe->res != -ECANCELED) submit_close(fd); return;     //成功或失败都关闭；链接在发送之后的被取消时由close_conn重新提交
+        case OP_CLOSE: return;
+        case OP_CANCEL: return;
+        default: break;
+    }
+
+    conn_state * state = m_conns[fd];
+    if(!state || (state->gen & 0xffffff) != gen)
+    {
+        if(op == OP_RECV && (cqe->flags & IORING_CQE_F_BUFFER) && cqe->res > 0)
+            m_ring->recycle_buffer((uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+        return;
+    }
+
+    switch(op)
+    {
+        case OP_RECV: on_recv(fd, cqe); break;
+        case OP_SEND: on_send(fd, cqe); break;
+        case OP_POLLOUT: on_pollout(fd, cqe); break;
+        default: break;
+    }
+}
+
+
+void uring_reactor::arm_accept()
+{
+    io_uring_sqe * sqe = m_ring->get_sqe();
+    if(!sqe) return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = m_listenfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;      //新连接直接是非阻塞的，不再需要fcntl
+    sqe->user_data = encode(OP_ACCEPT, 0, m_listenfd);
+}
+
+
+void uring_reactor::arm_wakeup()
+{
+    io_uring_sqe * sqe = m_ring->get_sqe();
+    if(!sqe) return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = m_wakeupfd;
+    sqe->addr = (uint64_t)(uintptr_t)&m_wakeup_buf;
+    sqe->len = sizeof(m_wakeup_buf);
+    sqe->user_data = encode(OP_WAKEUP, 0, m_wakeupfd);
+}
+
+
+/* multishot recv：每收到一段数据产生一个CQE，数据在内核选出的provided buffer中 */
+void uring_reactor::arm_recv(int fd)
+{
+    io_uring_sqe * sqe = m_ring->get_sqe();
+    if(!sqe)
+    {
+        close_conn(fd);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = encode(OP_RECV, m_conns[fd]->gen, fd);
+    m_conns[fd]->recv_armed = true;
+}
+
+
+/* 对端只发不收时暂存的数据会无限增长，达到上限后停止接收，由TCP流量控制让对端停下来 */
+void uring_reactor::pause_recv(int fd)
+{
+    conn_state * state = m_conns[fd];
+    if(state->recv_paused) return;
+    state->recv_paused = true;
+    if(!state->recv_armed) return;
+
+    io_uring_sqe * sqe = m_ring->get_sqe();
+    if(!sqe)
+    {
+        close_conn(fd);
+        return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = encode(OP_RECV, state->gen, fd);
+    sqe->user_data = encode(OP_CANCEL, state->gen, fd);
+}
+
+
+void uring_reactor::resume_recv(int fd)
+{
+    conn_state * state = m_conns[fd];
+    if(state->closing || state->pending.size() >= PENDING_LIMIT) return;
+    state->recv_paused = false;
+    if(!state->recv_armed) arm_recv(fd);
+}
+
+
+void uring_reactor::on_accept(io_uring_cqe * cqe)
+{
+    if(!(cqe->flags & IORING_CQE_F_MORE) && !m_stop) arm_accept();      //multishot accept被内核终止，重新提交
+    if(cqe->res < 0)
+    {
+        if(cqe->res != -EAGAIN && cqe->res != -ECANCELED) LOG_ERROR("accept failure, errno is : %d", -cqe->res);
+        return;
+    }
+
+    int connfd = cqe->res;
+    if(http_conn::m_user_count >= m_table->max_fd() || !m_table->acquire(connfd))
+    {
+        const char * info = "Internal Server Busy";
+        send(connfd, info, strlen(info), MSG_DONTWAIT);
+        close(connfd);
+        return;
+    }
+
+    /* multishot accept的所有完成事件共用一个地址缓冲区，无法可靠地取得对端地址；访问日志需要时由http_conn在第一次记录时getpeername */
+    struct sockaddr_in client_address;
+    memset(&client_address, 0, sizeof(client_address));
+
+    if(!m_conns[connfd]) m_conns[connfd] = new conn_state();
+    conn_state * state = m_conns[connfd];
+    state->gen++;
+    state->recv_armed = false;
+    state->recv_paused = false;
+    state->writing = false;
+    state->closing = false;
+    state->linked = false;
+    state->pending.clear();
+
+    m_table->http(connfd).init(connfd, client_address, -1);
+    set_timer(connfd, client_address);
+    arm_recv(connfd);
+}
+
+
+void uring_reactor::on_recv(int fd, io_uring_cqe * cqe)
+{
+    conn_state * state = m_conns[fd];
+    if(!(cqe->flags & IORING_CQE_F_MORE)) state->recv_armed = false;
+
+    if(cqe->res <= 0)
+    {
+        if(cqe->res == -ENOBUFS || cqe->res == -ECANCELED)      //缓冲区暂时用完，或被pause_recv取消
+        {
+            if(!state->recv_armed && !state->recv_paused) arm_recv(fd);
+            return;
+        }
+        /* 对端关闭或出错；正在发送响应时由发送完成事件决定连接的去留 */
+        if(!state->writing) close_conn(fd);
+        return;
+    }
+
+    uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    const char * data = m_ring->buffer(bid);
+    /* 上一个响应还没发完，或读缓冲区放不下，暂存到之后再解析，保持数据顺序 */
+    if(state->writing || !state->pending.empty()) state->pending.append(data, cqe->res);
+    else
+    {
+        int n = m_table->http(fd).read(data, cqe->res);
+        if(n < cqe->res) state->pending.append(data + n, cqe->res - n);
+    }
+    m_ring->recycle_buffer(bid);
+
+    /* 取消生效之前已在途的CQE仍会追加，多出的最多是provided buffer中已收下的数据 */
+    if(state->pending.size() >= PENDING_LIMIT) pause_recv(fd);
+    else if(!state->recv_armed && !state->recv_paused) arm_recv(fd);
+    if(!state->writing && !state->closing) process(fd);
+}
+
+
+void uring_reactor::process(int fd)
+{
+    conn_state * state = m_conns[fd];
+    while(true)
+    {
+        if(!m_table->http(fd).process())              //响应组装失败，http_conn已关闭连接，还需关闭fd
+        {
+            close_conn(fd);
+            return;
+        }
+        if(state->closing) return;
+        if(m_table->http(fd).writing())
+        {
+            start_write(fd);
+            return;
+        }
+
+        /* 解析腾出了读缓冲区，继续交给连接暂存的数据 */
+        if(state->pending.empty()) break;
+        int n = m_table->http(fd).read(state->pending.data(), (int)state->pending.size());
+        if(n == 0) break;
+        state->pending.erase(0, n);
+    }
+    resume_recv(fd);
+    if(state->closing) return;
+    adjust_timer(fd, m_request_timeout);
+}
+
+
+/*
+    短连接的响应与SHUTDOWN链接在一起，发送完毕内核立即结束连接。
+    CLOSE不能一起链接：fd号一旦被内核释放就可能被其他循环accept并使用同一个http_conn槽位，
+    所以CLOSE在SHUTDOWN完成后才提交，此时本循环已处理过发送完成事件并释放了槽位。
+*/
+void uring_reactor::start_write(int fd)
+{
+    conn_state * state = m_conns[fd];
+    state->writing = true;
+    adjust_timer(fd, m_request_timeout);
+
+    struct iovec * iv;
+    int count = m_table->http(fd).response_iov(&iv);
+    if(count == 0)
+    {
+        send_file(fd);
+        return;
+    }
+
+    state->to_send = 0;
+    for(int i = 0; i < count; i++) state->to_send += iv[i].iov_len;
+    memset(&state->msg, 0, sizeof(state->msg));
+    state->msg.msg_iov = iv;
+    state->msg.msg_iovlen = count;
+    state->linked = !m_table->http(fd).linger();
+
+    if(!m_ring->reserve(state->linked ? 2 : 1))
+    {
+        close_conn(fd);
+        return;
+    }
+
+    io_uring_sqe * sqe = m_ring->get_sqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)&state->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;           //流式socket上直到全部发送完毕才完成
+    sqe->user_data = encode(OP_SEND, state->gen, fd);
+    if(!state->linked) return;
+
+    sqe->flags = IOSQE_IO_LINK;
+    sqe = m_ring->get_sqe();
+    sqe->opcode = IORING_OP_SHUTDOWN;
+    sqe->fd = fd;
+    sqe->len = SHUT_RDWR;
+    sqe->user_data = encode(OP_SHUTDOWN, state->gen, fd);
+}
+
+
+void uring_reactor::on_send(int fd, io_uring_cqe * cqe)
+{
+    conn_state * state = m_conns[fd];
+    if(cqe->res < 0 || (size_t)cqe->res != state->to_send)
+    {
+        close_conn(fd);                         //发送失败时链接的SHUTDOWN被取消，重新提交SHUTDOWN和CLOSE
+        return;
+    }
+
+    if(state->linked)
+    {
+        m_table->http(fd).response_sent();
+        release(fd, state);                     //fd在链接的SHUTDOWN完成后关闭
+        return;
+    }
+    if(!m_table->http(fd).response_sent())
+    {
+        close_conn(fd);
+        return;
+    }
+    write_done(fd);
+}
+
+
+/* sendfile模式沿用http_conn::write()：写到EAGAIN时等待socket可写后继续 */
+void uring_reactor::send_file(int fd)
+{
+    conn_state * state = m_conns[fd];
+    if(!m_table->http(fd).write())
+    {
+        close_conn(fd);
+        return;
+    }
+    if(!m_table->http(fd).writing())
+    {
+        write_done(fd);
+        return;
+    }
+
+    io_uring_sqe * sqe = m_ring->get_sqe();
+    if(!sqe)
+    {
+        close_conn(fd);
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLOUT;
+    sqe->user_data = encode(OP_POLLOUT, state->gen, fd);
+}
+
+
+void uring_reactor::on_pollout(int fd, io_uring_cqe * cqe)
+{
+    if(cqe->res < 0)
+    {
+        close_conn(fd);
+        return;
+    }
+    adjust_timer(fd, m_request_timeout);
+    send_file(fd);
+}
+
+
+void uring_reactor::write_done(int fd)
+{
+    conn_state * state = m_conns[fd];
+    state->writing = false;
+    adjust_timer(fd, m_keepalive_timeout);
+
+    bool more = m_table->http(fd).pending_input() || !state->pending.empty();    //上一批留下的流水线请求或暂存的数据
+    resume_recv(fd);                            //对端已半关闭时会立即收到0并关闭连接
+    if(more && !state->closing) process(fd);
+}
+
+
+void uring_reactor::release(int fd, conn_state * state)
+{
+    m_timer_wheel->del_timer(&m_table->client(fd).wtimer);
+    m_table->http(fd).close_conn();
+    state->gen++;
+    state->closing = true;
+    state->writing = false;
+    std::string().swap(state->pending);         //连同容量一起释放
+}
+
+
+/*
+    先SHUTDOWN结束该fd上仍在进行的multishot recv，SHUTDOWN完成后再提交CLOSE。
+    不把CLOSE链接在SHUTDOWN之后：对端已重置时SHUTDOWN以ENOTCONN失败，链接的CLOSE会被取消，fd就泄漏了
+*/
+void uring_reactor::close_conn(int fd)
+{
+    conn_state * state = m_conns[fd];
+    if(state->closing) return;
+    release(fd, state);
+
+    io_uring_sqe * sqe = m_ring->get_sqe();
+    if(!sqe)
+    {
+        shutdown(fd, SHUT_RDWR);
+        close(fd);
+        return;
+    }
+    sqe->opcode = IORING_OP_SHUTDOWN;
+    sqe->fd = fd;
+    sqe->len = SHUT_RDWR;
+    sqe->user_data = encode(OP_SHUTDOWN, state->gen, fd);
+}
+
+
+void uring_reactor::submit_close(int fd)
+{
+    io_uring_sqe * sqe = m_ring->get_sqe();
+    if(!sqe)
+    {
+        close(fd);
+        return;
+    }
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->user_data = encode(OP_CLOSE, 0, fd);
+}
+
+
+/*******************定时器相关函数**********************/
+void uring_reactor::set_timer(int connfd, const sockaddr_in & client_address)
+{
+    client_data & client = m_table->client(connfd);
+    client.address = client_address;
+    client.sockfd = connfd;
+
+    wheel_timer* timer = &client.wtimer;
+    timer->user_data = &client;
+    timer->cb_func = cb_func;
+    timer->expire = m_now + m_request_timeout;
+    m_timer_wheel->add_timer(timer);
+}
+
+
+void uring_reactor::adjust_timer(int sockfd, int timeout)
+{
+    m_timer_wheel->mod_timer(&m_table->client(sockfd).wtimer, m_now + timeout);
+}
+
+
+/* 定时器回调函数：只shutdown socket，multishot recv随即以0完成，由正常的关闭流程回收连接 */
+void uring_reactor::cb_func(client_data * user_data)
+{
+    assert(user_data);
+    shutdown(user_data->sockfd, SHUT_RDWR);
+    LOG_DEBUG("close fd %d", user_data->sockfd);
+}
@@ -0,0 +1,110 @@
+#ifndef URING_REACTOR_H
+#define URING_REACTOR_H
+
+/*
+    io_uring后端：
+    与多反应堆模式一样每个线程一个循环、一个SO_REUSEPORT监听socket，但IO由io_uring完成：
+    1.multishot accept：一个SQE持续产生新连接；
+    2.multishot recv + provided buffer ring：内核直接把数据收进共享缓冲区，通过http_conn::read(data, len)交给连接；
+    3.响应的iovec由SENDMSG(MSG_WAITALL)发送，短连接的响应与SHUTDOWN链接成一条SQE链一次提交，SHUTDOWN完成后再CLOSE；
+      sendfile模式的大文件仍调用http_conn::write()，EAGAIN时用POLL_ADD等待可写；
+    4.定时器与epoll反应堆相同，等待超时直接通过io_uring_enter传给内核。
+    http_conn的read()/write()/process()约定保持不变，m_epollfd为-1时http_conn不操作epoll。
+*/
+
+#include <stdint.h>
+#include <string>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "../config/config.h"
+#include "../timer/timer_wheel.h"
+#include "../http_conn/http_conn.h"
+#include "event_loop.h"
+#include "reactor.h"
+#include "uring.h"
+
+class uring_reactor : public event_loop
+{
+    public:
+        uring_reactor(int listenfd, conn_table * table, const server_config & config);
+        ~uring_reactor();
+
+        void loop();
+        void stop();
+
+    private:
+        enum OP
+        {
+            OP_ACCEPT = 1,
+            OP_RECV,
+            OP_SEND,
+            OP_POLLOUT,
+            OP_SHUTDOWN,                //短连接响应链接的或close_conn提交的SHUTDOWN，完成后提交CLOSE
+            OP_CLOSE,
+            OP_CANCEL,                  //暂停接收时取消multishot recv
+            OP_WAKEUP
+        };
+
+        /* 每个fd在本后端中的状态，gen在连接建立和关闭时递增，用来丢弃旧连接残留的CQE */
+        struct conn_state
+        {
+            uint32_t gen;
+            bool recv_armed;            //multishot recv是否仍在进行
+            bool recv_paused;           //暂存的数据达到上限，解析消耗之前不再接收
+            bool writing;               //响应是否正在发送
+            bool closing;               //已提交关闭
+            bool linked;                //SENDMSG后面链接了SHUTDOWN
+            size_t to_send;             //SENDMSG应发送的字节数
+            struct msghdr msg;
+            std::string pending;        //发送响应期间收到的或读缓冲区放不下的数据，之后再交给连接
+        };
+
+        static uint64_t encode(int op, uint32_t gen, int fd) { return ((uint64_t)op << 56) | ((uint64_t)(gen & 0xffffff) << 32) | (uint32_t)fd; }
+        void handle(io_uring_cqe * cqe);
+
+        void arm_accept();
+        void arm_recv(int fd);
+        void pause_recv(int fd);                //取消multishot recv，剩下的数据留在socket中
+        void resume_recv(int fd);               //暂存的数据降到上限以下时恢复接收
+        void arm_wakeup();
+        void on_accept(io_uring_cqe * cqe);
+        void on_recv(int fd, io_uring_cqe * cqe);
+        void on_send(int fd, io_uring_cqe * cqe);
+        void on_pollout(int fd, io_uring_cqe * cqe);
+
+        void process(int fd);                   //解析请求，有响应时开始发送
+        void start_write(int fd);
+        void send_file(int fd);                 //sendfile模式的响应，socket不可写时等待POLLOUT
+        void write_done(int fd);                //响应发送完毕，长连接继续处理已到达的数据
+        void close_conn(int fd);                //关闭连接并异步关闭fd
+        void release(int fd, conn_state * state);   //连接失效，之后该fd上残留的CQE都会被丢弃
+        void submit_close(int fd);
+
+        /* 定时器相关函数 */
+        void set_timer(int connfd, const sockaddr_in & client_address);
+        void adjust_timer(int sockfd, int timeout);
+        static void cb_func(client_data * user_data);
+
+    private:
+        static const unsigned RING_ENTRIES = 1024;
+        static const unsigned RECV_BUFFER_COUNT = 1024;
+        static const unsigned RECV_BUFFER_SIZE = 4096;
+        static const uint16_t BUFFER_GROUP = 0;
+        static const size_t PENDING_LIMIT = buffer_pool::LARGE_SIZE;     //每个连接暂存数据的上限，与epoll后端读缓冲区的最大规格相同
+
+        uring * m_ring;
+        int m_listenfd;
+        int m_wakeupfd;
+        uint64_t m_wakeup_buf;
+        volatile bool m_stop;
+        uint64_t m_now;
+        int m_request_timeout;
+        int m_keepalive_timeout;
+        conn_table * m_table;
+        conn_state ** m_conns;                  //按fd索引，首次使用时分配；指针数组用calloc分配，只有用到的页才占用物理内存
+        timer_wheel * m_timer_wheel;
+};
+
+
+#endif
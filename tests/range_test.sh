@@ -0,0 +1,66 @@
+#!/bin/sh
+# Range请求的端到端测试：文件大于-S阈值时由sendfile发送，向它请求两个区间，
+# 检查响应是206的multipart/byteranges、Content-Length与实际消息体一致，且消息体只包含这两个区间而不是整个文件。
+#
+# 用法：tests/range_test.sh SERVER [server args...]
+# 环境变量：PORT 端口(默认9106)，被占用(如上一次运行留下的TIME_WAIT)时依次尝试之后的端口
+
+set -e
+
+SERVER=$(realpath "$1")
+shift
+PORT=${PORT:-9106}
+SIZE=200000
+
+ROOT=$(mktemp -d)
+trap 'kill $SERVER_PID 2>/dev/null; rm -rf "$ROOT"' EXIT INT TERM
+head -c $SIZE /dev/urandom > "$ROOT/big.bin"
+cd "$ROOT"
+
+for attempt in 1 2 3 4 5 6 7 8; do
+    "$SERVER" -S 4096 "$@" 127.0.0.1 "$PORT" > server.log 2>&1 &
+    SERVER_PID=$!
+    sleep 0.5
+    kill -0 $SERVER_PID 2>/dev/null && break
+    PORT=$((PORT + 10))
+done
+if ! kill -0 $SERVER_PID 2>/dev/null; then
+    cat server.log
+    exit 1
+fi
+
+fail() {
+    echo "FAIL: $*"
+    cat headers
+    exit 1
+}
+
+# 区间[first, last]的内容
+slice() {
+    tail -c +$(($1 + 1)) big.bin | head -c $(($2 - $1 + 1))
+}
+
+curl -s -r 0-99,150000-150099 -D headers -o body "http://127.0.0.1:$PORT/big.bin"
+tr -d '\r' < headers > headers.txt
+grep -q '^HTTP/1.1 206' headers.txt || fail "status is not 206"
+boundary=$(sed -n 's/^Content-Type: multipart\/byteranges; boundary=//p' headers.txt)
+[ -n "$boundary" ] || fail "not multipart/byteranges"
+length=$(sed -n 's/^Content-Length: //p' headers.txt)
+[ "$length" = "$(wc -c < body)" ] || fail "Content-Length $length, body $(wc -c < body) bytes"
+[ "$length" -lt 1000 ] || fail "body of $length bytes for two 100-byte ranges"
+
+{
+    printf '\r\n--%s\r\nContent-Type: application/octet-stream\r\nContent-Range: bytes 0-99/%d\r\n\r\n' "$boundary" $SIZE
+    slice 0 99
+    printf '\r\n--%s\r\nContent-Type: application/octet-stream\r\nContent-Range: bytes 150000-150099/%d\r\n\r\n' "$boundary" $SIZE
+    slice 150000 150099
+    printf '\r\n--%s--\r\n' "$boundary"
+} > expected
+cmp -s body expected || fail "multipart body differs from the requested ranges"
+
+# 同一连接上紧接着的请求不受上一个响应的影响
+curl -s -r 10-19 -o single "http://127.0.0.1:$PORT/big.bin" --next -s -o full "http://127.0.0.1:$PORT/big.bin"
+slice 10 19 | cmp -s single - || fail "single range differs"
+cmp -s full big.bin || fail "full response differs"
+
+echo "range test passed"
@@ -44,8 +44,9 @@ class locker
         }
 
         ~locker() { pthread_mutex_destroy(&m_mutex); }
-        bool lock() { pthread_mutex_lock(&m_mutex); }       //获取互斥锁
-        bool unlock() { pthread_mutex_unlock(&m_mutex); }       //释放互斥锁
+        bool lock() { return pthread_mutex_lock(&m_mutex) == 0; }       //获取互斥锁
+        bool unlock() { return pthread_mutex_unlock(&m_mutex) == 0; }       //释放互斥锁
+        pthread_mutex_t * get() { return &m_mutex; }                          //获取底层互斥锁，供条件变量使用
 };
 
 /* 封装条件变量的类 */
@@ -80,11 +81,23 @@ class cond
             return ret == 0;
         }
 
+        /*在调用者已持有的外部互斥锁上等待条件变量*/
+        bool wait(pthread_mutex_t * m_mutex)
+        {
+            return pthread_cond_wait(&m_cond, m_mutex) == 0;
+        }
+
         /*唤醒等待条件变量的线程*/
         bool signal()
         {
             return pthread_cond_signal(&m_cond);
         }
+
+        /*唤醒所有等待条件变量的线程*/
+        bool broadcast()
+        {
+            return pthread_cond_broadcast(&m_cond) == 0;
+        }
 };
 
 
@@ -0,0 +1,155 @@
+#ifndef TASK_QUEUE_H
+#define TASK_QUEUE_H
+
+/*
+    3.线程池任务队列策略：
+    threadpool通过模板参数选择队列实现，两种队列接口一致：
+        explicit Queue(int capacity);
+        bool push(T * request);     //队列满时返回false
+        T * pop();                  //队列空时返回NULL
+    1.locked_queue：std::list + 互斥锁，即原来的实现，每个任务一次堆分配和两次加解锁；
+    2.mpmc_queue：有界无锁多生产者多消费者环形队列(Dmitry Vyukov算法)，无堆分配，
+      入队和出队各只需一次CAS，头尾下标分别独占缓存行以避免伪共享。
+*/
+
+#include <list>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+#include "locker.h"
+
+#define CACHELINE_SIZE 64
+
+
+template<typename T>
+class locked_queue
+{
+    public:
+        explicit locked_queue(int capacity) : m_capacity(capacity) {}
+
+        bool push(T * request)
+        {
+            m_locker.lock();
+            if(m_queue.size() >= (size_t)m_capacity)
+            {
+                m_locker.unlock();
+                return false;
+            }
+            m_queue.push_back(request);
+            m_locker.unlock();
+            return true;
+        }
+
+        T * pop()
+        {
+            m_locker.lock();
+            if(m_queue.empty())
+            {
+                m_locker.unlock();
+                return NULL;
+            }
+            T * request = m_queue.front();
+            m_queue.pop_front();
+            m_locker.unlock();
+            return request;
+        }
+
+    private:
+        int m_capacity;
+        std::list<T*> m_queue;
+        locker m_locker;
+};
+
+
+template<typename T>
+class mpmc_queue
+{
+    public:
+        explicit mpmc_queue(int capacity);
+        ~mpmc_queue() { delete [] m_cells; }
+
+        bool push(T * request);
+        T * pop();
+
+    private:
+        /* 每个槽位带一个序号：序号==pos表示可写，序号==pos+1表示可读 */
+        struct cell
+        {
+            std::atomic<size_t> sequence;
+            T * data;
+        };
+
+        mpmc_queue(const mpmc_queue &);
+        mpmc_queue & operator=(const mpmc_queue &);
+
+    private:
+        cell * m_cells;
+        size_t m_mask;                                              //容量向上取整为2的幂，下标用掩码取模
+        alignas(CACHELINE_SIZE) std::atomic<size_t> m_enqueue_pos;  //生产者下标，独占缓存行
+        alignas(CACHELINE_SIZE) std::atomic<size_t> m_dequeue_pos;  //消费者下标，独占缓存行
+        char m_pad[CACHELINE_SIZE - sizeof(std::atomic<size_t>)];
+};
+
+
+template<typename T>
+mpmc_queue<T>::mpmc_queue(int capacity) : m_enqueue_pos(0), m_dequeue_pos(0)
+{
+    if(capacity <= 0) throw std::exception();
+
+    size_t size = 2;
+    while(size < (size_t)capacity) size <<= 1;
+    m_mask = size - 1;
+    m_cells = new cell[size];
+    for(size_t i = 0; i < size; i++) m_cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+
+template<typename T>
+bool mpmc_queue<T>::push(T * request)
+{
+    cell * c;
+    size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    while(true)
+    {
+        c = &m_cells[pos & m_mask];
+        size_t seq = c->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if(diff == 0)
+        {
+            if(m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if(diff < 0) return false;                             //槽位还未被消费，队列已满
+        else pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    }
+    c->data = request;
+    c->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+
+template<typename T>
+T * mpmc_queue<T>::pop()
+{
+    cell * c;
+    size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    while(true)
+    {
+        c = &m_cells[pos & m_mask];
+        size_t seq = c->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if(diff == 0)
+        {
+            if(m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if(diff < 0) return NULL;                              //槽位还未被写入，队列为空
+        else pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    }
+    T * request = c->data;
+    c->sequence.store(pos + m_mask + 1, std::memory_order_release);
+    return request;
+}
+
+
+#endif
@@ -5,61 +5,87 @@
     2.线程池模块：
     半同步/半反应堆线程池，其使用一个工作队列解除主线程和工作线程的耦合关系
     主线程往工作队列中插入任务，工作线程通过竞争来取得任务并执行任务。
+    工作队列由模板参数Queue指定(见task_queue.h)，默认使用无锁环形队列；
+    信号量只在有空闲线程睡眠时才post，繁忙时入队出队不经过任何锁和系统调用。
+    构造时可选择工作窃取模式：每个线程拥有自己的队列，append轮流分发到各线程的队列，
+    线程自己的队列为空时从其他线程的队列中窃取任务，避免处理时间差异很大(404与大文件)时部分线程空闲而部分队列积压。
+    任务类型T需要提供process()，以及记录入队时间的set_queued(us)和queued()，启用指标时用来统计排队时间。
 */
 
-#include <list>
+#include <atomic>
 #include <cstdio>
 #include <exception>
 #include <pthread.h>
+#include <sched.h>
 
 #include "locker.h"
+#include "task_queue.h"
+#include "../log/log.h"
+#include "../timer/clock.h"
+#include "../metrics/metrics.h"
 
-template<typename T>
+template<typename T, typename Queue = mpmc_queue<T> >
 class threadpool
 {
     public:
-        threadpool( int thread_number = 8, int max_requests = 10000 );
+        threadpool( int thread_number = 8, int max_requests = 10000, bool work_stealing = false );
         ~threadpool();
         bool append(T * request);       //往请求队列中添加任务
-    
+
     private:
         /* 工作线程运行的函数，其不断从工作队列中取出任务并执行 */
         static void * worker(void * arg);
         void run();
-        
+        T * take(int index);            //取任务，队列为空时先自旋再睡眠，返回NULL表示线程池结束
+        T * try_pop(int index);         //从自己的队列取任务，工作窃取模式下再依次尝试其他线程的队列
+
     private:
+        static const int SPIN_COUNT = 64;               //睡眠前的自旋次数
+
         int m_thread_number;            //线程池中的线程数
         int m_max_requests;             //请求队列中允许的最大请求数量
         pthread_t * m_threads;          //描述线程池的数组，大小为m_thread_number
-        std::list<T*> m_workqueue;      //请求队列
-        locker m_queuelocker;           //保护请求队列的互斥锁
+        bool m_work_stealing;           //是否为工作窃取模式
+        int m_queue_number;             //请求队列数，共享队列模式为1，工作窃取模式为m_thread_number
+        Queue ** m_workqueues;          //请求队列，各自独立分配以避免伪共享
         sem m_queuestat;                //是否有任务需要处理
-        bool m_stop;                    //是否结束线程
+        std::atomic<int> m_next_index;              //分配给工作线程的队列下标
+        alignas(CACHELINE_SIZE) std::atomic<unsigned> m_dispatch;  //append轮流分发的计数
+        alignas(CACHELINE_SIZE) std::atomic<int> m_idle;        //正在睡眠或准备睡眠的线程数
+        alignas(CACHELINE_SIZE) std::atomic<bool> m_stop;       //是否结束线程，和m_idle各占一个缓存行
+        char m_pad[CACHELINE_SIZE - sizeof(std::atomic<bool>)];
 };
 
 
 /* 实现部分 */
 
 /* 线程池构造函数实现 */
-template<typename T>
-threadpool<T>::threadpool(int thread_number, int max_requests) : m_thread_number(thread_number), m_max_requests(max_requests), m_stop(false), m_threads(NULL)
+template<typename T, typename Queue>
+threadpool<T, Queue>::threadpool(int thread_number, int max_requests, bool work_stealing) : m_thread_number(thread_number), m_max_requests(max_requests), m_threads(NULL), m_work_stealing(work_stealing), m_next_index(0), m_dispatch(0), m_idle(0), m_stop(false)
 {
     if(thread_number <= 0 || max_requests <= 0) throw std::exception();
 
+    /* 工作窃取模式下总容量仍为max_requests，平均分给各线程 */
+    m_queue_number = m_work_stealing ? m_thread_number : 1;
+    int capacity = m_max_requests / m_queue_number;
+    if(capacity <= 0) capacity = 1;
+    m_workqueues = new Queue*[m_queue_number];
+    for(int i = 0; i < m_queue_number; i++) m_workqueues[i] = new Queue(capacity);
+
     m_threads = new pthread_t[m_thread_number];
     if(!m_threads) throw std::exception();
 
-    /* 创建指定数量线程， */
+    /* 创建指定数量线程，析构时join回收 */
     for(int i = 0; i < thread_number; i++)
     {
-        printf("create the %dth thread\n", i);
+        LOG_INFO("create the %dth thread", i);
         if(pthread_create(m_threads + i, NULL, worker, this) != 0)
         {
-            delete [] m_threads;
-            throw std::exception();
-        }
-        if(pthread_detach(m_threads[i]))
-        {
+            m_stop = true;
+            for(int j = 0; j < i; j++) m_queuestat.post();
+            for(int j = 0; j < i; j++) pthread_join(m_threads[j], NULL);
+            for(int j = 0; j < m_queue_number; j++) delete m_workqueues[j];
+            delete [] m_workqueues;
             delete [] m_threads;
             throw std::exception();
         }
@@ -68,32 +94,56 @@ threadpool<T>::threadpool(int thread_number, int max_requests) : m_thread_number
 
 
 /* 线程池析构函数实现 */
-template<typename T>
-threadpool<T>::~threadpool()
+template<typename T, typename Queue>
+threadpool<T, Queue>::~threadpool()
 {
-    delete [] m_threads;
     m_stop = true;
+    for(int i = 0; i < m_thread_number; i++) m_queuestat.post();        //唤醒所有睡眠的线程使其退出
+    for(int i = 0; i < m_thread_number; i++) pthread_join(m_threads[i], NULL);
+    for(int i = 0; i < m_queue_number; i++) delete m_workqueues[i];
+    delete [] m_workqueues;
+    delete [] m_threads;
 }
 
 /* 向队列中添加任务函数实现 */
-template<typename T>
-bool threadpool<T>::append(T * request)
+template<typename T, typename Queue>
+bool threadpool<T, Queue>::append(T * request)
 {
-    m_queuelocker.lock();                       //因为工作队列被所有线程共享，所以操作时需要加锁
-    if(m_workqueue.size() > m_max_requests)
+    if(metrics::enabled()) request->set_queued(monotonic_us());     //入队之后任务可能立即被取走，必须先记录
+    if(m_queue_number == 1)
     {
-        m_queuelocker.unlock();
-        return false;
+        if(!m_workqueues[0]->push(request))
+        {
+            metrics::add(CNT_QUEUE_REJECTED);
+            return false;
+        }
     }
-    m_workqueue.push_back(request);
-    m_queuelocker.unlock();
-    m_queuestat.post();                         //通知工作线程有任务加入
+    else
+    {
+        /* 轮流分发到各线程的队列，目标队列满时顺延到下一个 */
+        unsigned start = m_dispatch.fetch_add(1, std::memory_order_relaxed);
+        int i = 0;
+        for(; i < m_queue_number; i++)
+        {
+            if(m_workqueues[(start + i) % m_queue_number]->push(request)) break;
+        }
+        if(i == m_queue_number)
+        {
+            metrics::add(CNT_QUEUE_REJECTED);
+            return false;
+        }
+    }
+    metrics::gauge_add(GAUGE_QUEUE_DEPTH, 1);
+
+    /* 入队与读取m_idle之间需要全屏障，与take()中先增加m_idle再检查队列配对，保证不会丢失唤醒 */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_idle.load(std::memory_order_relaxed) > 0) m_queuestat.post();     //只有存在睡眠线程时才通知
     return true;
 }
 
 /* 线程运行函数实现 */
-template<typename T>
-void * threadpool<T>::worker(void * arg)
+template<typename T, typename Queue>
+void * threadpool<T, Queue>::worker(void * arg)
 {
     threadpool * pool = (threadpool * ) arg;
     pool->run();
@@ -101,22 +151,60 @@ void * threadpool<T>::worker(void * arg)
 }
 
 
-template<typename T>
-void threadpool<T>::run()
+template<typename T, typename Queue>
+T * threadpool<T, Queue>::try_pop(int index)
 {
-    while(!m_stop)
+    if(m_queue_number == 1) return m_workqueues[0]->pop();
+
+    /* 先取自己的队列，再从相邻线程开始依次窃取 */
+    for(int i = 0; i < m_queue_number; i++)
     {
+        T * request = m_workqueues[(index + i) % m_queue_number]->pop();
+        if(request) return request;
+    }
+    return NULL;
+}
+
+
+template<typename T, typename Queue>
+T * threadpool<T, Queue>::take(int index)
+{
+    while(!m_stop.load(std::memory_order_relaxed))
+    {
+        for(int i = 0; i < SPIN_COUNT; i++)
+        {
+            T * request = try_pop(index);
+            if(request) return request;
+            sched_yield();
+        }
+
+        /* 先登记为空闲再检查一次队列，之后才睡眠 */
+        m_idle.fetch_add(1, std::memory_order_seq_cst);
+        T * request = try_pop(index);
+        if(request)
+        {
+            m_idle.fetch_sub(1, std::memory_order_relaxed);
+            return request;
+        }
         m_queuestat.wait();
-        m_queuelocker.lock();
-        if(m_workqueue.empty())
+        m_idle.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return NULL;
+}
+
+
+template<typename T, typename Queue>
+void threadpool<T, Queue>::run()
+{
+    int index = m_next_index.fetch_add(1, std::memory_order_relaxed);
+    T * request;
+    while((request = take(index)) != NULL)
+    {
+        if(metrics::enabled())
         {
-            m_queuelocker.unlock();
-            continue;
+            metrics::gauge_add(GAUGE_QUEUE_DEPTH, -1);
+            metrics::record(STAGE_QUEUE_WAIT, monotonic_us() - request->queued());
         }
-        T* request = m_workqueue.front();
-        m_workqueue.pop_front();
-        m_queuelocker.unlock();
-        if(!request) continue;
         request->process();                 //线程进行任务处理
     }
 }
@@ -0,0 +1,29 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+/*
+    单调时钟，毫秒精度：
+    CLOCK_MONOTONIC_COARSE直接读取vDSO中内核缓存的时间，不陷入内核，精度为一个内核tick(1~4ms)，
+    且不受系统时间调整影响。reactor每轮epoll_wait返回后读取一次并缓存，同一轮内的定时器操作共用该值。
+    需要测量耗时的地方用微秒精度的monotonic_us()，同样经过vDSO。
+*/
+
+#include <stdint.h>
+#include <time.h>
+
+inline uint64_t monotonic_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+inline uint64_t monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+#endif
@@ -1,10 +1,10 @@
 #include "timer.h"
+#include "../log/log.h"
 
 
 /* 构造函数之一：初始化一个大小为cap的空堆 */
 time_heap::time_heap(int cap) : capacity(cap), cur_size(0)
 {
-    printf("the cur_size= %d\n", cur_size);
     array = new heap_timer* [capacity];                       //创建堆数组
     if(!array) throw std::exception();
 
@@ -74,16 +74,15 @@ void time_heap::pop_timer()
 }
 
 
-void time_heap::tick()
+void time_heap::tick(time_t cur)
 {
     heap_timer* tmp = array[0];
-    time_t cur = time(NULL);
 
     /* 循环处理堆中到期的定时器 */
     while(!empty())
     {
         if(!tmp) break;
-        printf("this conn expire= %ld, now cur= %ld\n", tmp->expire, cur);
+        LOG_DEBUG("this conn expire= %ld, now cur= %ld", (long)tmp->expire, (long)cur);
         if(tmp->expire > cur) break;                                    //如果堆顶元素未到期则退出循环
 
         if(array[0]->cb_func) array[0]->cb_func(array[0]->user_data);   //否则执行堆顶定时器的任务
@@ -113,9 +112,7 @@ void time_heap::percolate_down(int hole)
 
 void time_heap::resize()
 {
-    printf("do resize1\n");
     heap_timer** tmp = new heap_timer* [2 * capacity];
-    printf("do resize2\n");
     for(int i = 0; i < 2 * capacity; i++) tmp[i] = NULL;
 
     if(!tmp) throw std::exception();
@@ -3,6 +3,7 @@
 
 /*
     基于时间堆的定时器类
+    服务器已改用timer_wheel.h中的时间轮，时间堆只供bench/timer_bench.cpp与时间轮对比
 */
 
 #include <iostream>
@@ -14,8 +15,8 @@
 class heap_timer;         //前向声明
 
 
-/* 绑定socket和定时器 */
-struct client_data
+/* 绑定socket和时间堆定时器 */
+struct heap_client_data
 {
     sockaddr_in address;
     int sockfd;
@@ -29,8 +30,8 @@ class heap_timer
 {
     public:
         time_t expire;              //定时器生效的绝对时间
-        void (*cb_func) (client_data *);        //定时器的回调函数
-        client_data * user_data;
+        void (*cb_func) (heap_client_data *);   //定时器的回调函数
+        heap_client_data * user_data;
     public:
         heap_timer() : expire(0) {};
         heap_timer(int delay)
@@ -66,8 +67,9 @@ class time_heap
         void del_timer(heap_timer * timer);       //删除目标定时器timer
         heap_timer * top() const;                 //获取堆顶的定时器
         void pop_timer();                           //删除堆顶定时器
-        void tick();                                //心搏函数
+        void tick(time_t now);                      //心搏函数，执行所有expire <= now的定时器
         bool empty() const { return cur_size == 0; }
+        int size() const { return cur_size; }      //包括已延迟删除、还未弹出的定时器
 };
 
 
@@ -0,0 +1,183 @@
+#include "timer_wheel.h"
+
+
+static inline void list_init(timer_node * head)
+{
+    head->prev = head->next = head;
+}
+
+
+static inline void list_add_tail(timer_node * head, timer_node * node)
+{
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+
+/* 把head链表整体转移到tmp上，head置为空 */
+static inline void list_replace_init(timer_node * head, timer_node * tmp)
+{
+    if(head->next == head)
+    {
+        list_init(tmp);
+        return;
+    }
+    tmp->next = head->next;
+    tmp->prev = head->prev;
+    tmp->next->prev = tmp;
+    tmp->prev->next = tmp;
+    list_init(head);
+}
+
+
+timer_wheel::timer_wheel(uint64_t now) : m_jiffies(now), m_count(0)
+{
+    for(int i = 0; i < ROOT_SIZE; i++) list_init(&m_root[i]);
+    for(int i = 0; i < LEVELS; i++)
+        for(int j = 0; j < LEVEL_SIZE; j++) list_init(&m_levels[i][j]);
+}
+
+
+void timer_wheel::link(wheel_timer * timer)
+{
+    uint64_t expire = timer->expire;
+    uint64_t idx = expire - m_jiffies;
+    timer_node * head;
+
+    if((int64_t)idx < 0)
+    {
+        head = &m_root[m_jiffies & (ROOT_SIZE - 1)];                //已经过期，放到下一个要处理的槽
+    }
+    else if(idx < ROOT_SIZE)
+    {
+        head = &m_root[expire & (ROOT_SIZE - 1)];
+    }
+    else
+    {
+        /* 找到能容纳idx的最低层 */
+        int level = 0;
+        for(; level < LEVELS - 1; level++)
+        {
+            if(idx < (1ULL << (ROOT_BITS + (level + 1) * LEVEL_BITS))) break;
+        }
+        if(level == LEVELS - 1 && idx >= (1ULL << (ROOT_BITS + LEVELS * LEVEL_BITS)))
+        {
+            expire = m_jiffies + (1ULL << (ROOT_BITS + LEVELS * LEVEL_BITS)) - 1;  //超出范围的按最大值处理
+        }
+        int shift = ROOT_BITS + level * LEVEL_BITS;
+        head = &m_levels[level][(expire >> shift) & (LEVEL_SIZE - 1)];
+    }
+    list_add_tail(head, timer);
+}
+
+
+void timer_wheel::unlink(wheel_timer * timer)
+{
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = timer->next = NULL;
+}
+
+
+void timer_wheel::add_timer(wheel_timer * timer)
+{
+    if(!timer) return;
+    if(timer->pending()) unlink(timer);
+    else m_count++;
+    link(timer);
+}
+
+
+void timer_wheel::mod_timer(wheel_timer * timer, uint64_t expire)
+{
+    if(!timer) return;
+    timer->expire = expire;
+    add_timer(timer);
+}
+
+
+void timer_wheel::del_timer(wheel_timer * timer)
+{
+    if(!timer || !timer->pending()) return;
+    unlink(timer);
+    m_count--;
+}
+
+
+int timer_wheel::cascade(int level, int index)
+{
+    timer_node tmp;
+    list_replace_init(&m_levels[level][index], &tmp);
+    while(tmp.next != &tmp)
+    {
+        wheel_timer * timer = static_cast<wheel_timer *>(tmp.next);
+        unlink(timer);
+        link(timer);
+    }
+    return index;
+}
+
+
+int timer_wheel::next_timeout(uint64_t now) const
+{
+    if(m_count == 0) return -1;
+
+    /* 只扫描第0层到下一次级联为止，级联点本身就是一个需要醒来的时间，高层的定时器不会早于它到期 */
+    uint64_t next = (m_jiffies | (ROOT_SIZE - 1)) + 1;
+    for(uint64_t t = m_jiffies; t < next; t++)
+    {
+        const timer_node * head = &m_root[t & (ROOT_SIZE - 1)];
+        if(head->next != head)
+        {
+            next = t;
+            break;
+        }
+    }
+    if(next <= now) return 0;
+    return (next - now > 0x7fffffff) ? 0x7fffffff : (int)(next - now);
+}
+
+
+void timer_wheel::tick(uint64_t now)
+{
+    /* 时间轮上没有定时器时直接跳到当前时间，避免空转 */
+    if(m_count == 0)
+    {
+        if(now >= m_jiffies) m_jiffies = now + 1;
+        return;
+    }
+
+    while(m_jiffies <= now)
+    {
+        int index = m_jiffies & (ROOT_SIZE - 1);
+
+        /* 第0层转完一圈时，逐层把上一层对应的槽重新分散下来 */
+        if(index == 0)
+        {
+            for(int level = 0; level < LEVELS; level++)
+            {
+                int shift = ROOT_BITS + level * LEVEL_BITS;
+                if(cascade(level, (m_jiffies >> shift) & (LEVEL_SIZE - 1)) != 0) break;
+            }
+        }
+        m_jiffies++;
+
+        /* 先把整个槽摘下来，回调中可以安全地增删定时器 */
+        timer_node expired;
+        list_replace_init(&m_root[index], &expired);
+        while(expired.next != &expired)
+        {
+            wheel_timer * timer = static_cast<wheel_timer *>(expired.next);
+            unlink(timer);
+            m_count--;
+            if(timer->cb_func) timer->cb_func(timer->user_data);
+        }
+        if(m_count == 0)
+        {
+            if(now >= m_jiffies) m_jiffies = now + 1;
+            return;
+        }
+    }
+}
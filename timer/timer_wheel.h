@@ -0,0 +1,84 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+/*
+    分层时间轮定时器：
+    与Linux内核经典的timer wheel相同，第0层256个槽，第1~4层各64个槽，共覆盖2^32个时间单位。
+    定时器是侵入式的(链表指针就在定时器内部)，嵌入在client_data中，不需要为每个连接单独new；
+    添加、重新设置超时时间和删除都是O(1)的链表操作，删除会真正把定时器从槽中摘除。
+    时间单位由使用者决定，只要tick()和expire使用同一个时钟即可。
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>
+
+struct client_data;         //前向声明
+
+
+/* 双向链表节点，每个槽的表头是一个哨兵节点 */
+struct timer_node
+{
+    timer_node * prev;
+    timer_node * next;
+};
+
+
+/* 时间轮定时器 */
+class wheel_timer : public timer_node
+{
+    public:
+        uint64_t expire;                            //定时器生效的绝对时间
+        void (*cb_func) (client_data *);            //定时器的回调函数
+        client_data * user_data;
+
+    public:
+        wheel_timer() : expire(0), cb_func(NULL), user_data(NULL) { prev = next = NULL; }
+        bool pending() const { return next != NULL; }      //是否挂在时间轮上
+};
+
+
+/* 绑定socket和定时器，按fd索引 */
+struct client_data
+{
+    sockaddr_in address;
+    int sockfd;
+    wheel_timer wtimer;         //时间轮定时器，侵入式，随client_data一起分配
+};
+
+
+/* 时间轮类 */
+class timer_wheel
+{
+    private:
+        static const int ROOT_BITS = 8;
+        static const int LEVEL_BITS = 6;
+        static const int ROOT_SIZE = 1 << ROOT_BITS;
+        static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+        static const int LEVELS = 4;                //第0层之外的层数
+
+        timer_node m_root[ROOT_SIZE];               //第0层，每个槽对应一个时间单位
+        timer_node m_levels[LEVELS][LEVEL_SIZE];    //第1~4层，每个槽对应上一层转一圈的时间
+        uint64_t m_jiffies;                         //下一个要处理的时间单位
+        int m_count;                                //时间轮上的定时器个数
+
+    private:
+        void link(wheel_timer * timer);             //按超时时间挂到对应的槽
+        static void unlink(wheel_timer * timer);
+        int cascade(int level, int index);          //把高层的一个槽重新分散到低层
+
+    public:
+        explicit timer_wheel(uint64_t now);
+
+    public:
+        void add_timer(wheel_timer * timer);                        //按timer->expire添加定时器，已在轮上则重新设置
+        void mod_timer(wheel_timer * timer, uint64_t expire);       //修改超时时间，O(1)
+        void del_timer(wheel_timer * timer);                        //从时间轮上摘除定时器
+        void tick(uint64_t now);                                    //执行所有expire <= now的定时器
+        int next_timeout(uint64_t now) const;                       //距离下一次需要tick的时间，用作epoll_wait的超时，-1表示没有定时器
+        bool empty() const { return m_count == 0; }
+        int size() const { return m_count; }
+};
+
+
+#endif
@@ -0,0 +1,147 @@
+/*
+    二进制访问日志转换工具：
+    读取access_log写出的一个或多个文件，按记录输出文本(每行一条，类似common log format)或JSON(每行一个对象)。
+    多个文件的记录按时间合并排序后输出。
+
+    编译：g++ -std=c++17 -O2 tools/access_log_dump.cpp -o access_log_dump
+    运行：./access_log_dump [-j] file...
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../log/access_log.h"
+
+
+static const char * const METHODS[] = { "GET", "POST", "HEAD", "PUT", "DELETE", "TRACE", "OPTIONS", "CONNECT", "PATCH" };
+
+
+/* 读取一个文件中已写完的记录，文件格式不对时返回false */
+static bool load(const char * path, std::vector<access_record> & out)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        perror(path);
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(access_log_header))
+    {
+        fprintf(stderr, "%s: not an access log\n", path);
+        close(fd);
+        return false;
+    }
+    void * addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED)
+    {
+        perror(path);
+        return false;
+    }
+
+    const access_log_header * header = (const access_log_header *)addr;
+    bool ok = memcmp(header->magic, ACCESS_LOG_MAGIC, 8) == 0 && header->version == ACCESS_LOG_VERSION
+              && header->record_size == sizeof(access_record);
+    if(ok)
+    {
+        uint64_t count = __atomic_load_n(&header->count, __ATOMIC_ACQUIRE);
+        uint64_t fit = (st.st_size - sizeof(access_log_header)) / sizeof(access_record);
+        const access_record * records = (const access_record *)(header + 1);
+        out.insert(out.end(), records, records + std::min(count, fit));
+    }
+    else fprintf(stderr, "%s: not an access log\n", path);
+    munmap(addr, st.st_size);
+    return ok;
+}
+
+
+/* JSON字符串转义 */
+static std::string escape(const char * s, size_t len)
+{
+    std::string out;
+    for(size_t i = 0; i < len; i++)
+    {
+        unsigned char c = s[i];
+        if(c == '"' || c == '\\') out += '\\', out += c;
+        else if(c < 0x20)
+        {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        }
+        else out += c;
+    }
+    return out;
+}
+
+
+static void print(const access_record & r, bool json)
+{
+    char addr[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = r.addr;
+    inet_ntop(AF_INET, &in, addr, sizeof(addr));
+
+    time_t sec = r.time_us / 1000000;
+    struct tm tm;
+    localtime_r(&sec, &tm);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+
+    size_t url_len = strnlen(r.url, ACCESS_URL_LEN);
+    const char * method = r.method < sizeof(METHODS) / sizeof(METHODS[0]) ? METHODS[r.method] : "-";
+    bool truncated = r.url_len > url_len;
+
+    if(json)
+    {
+        printf("{\"time\":\"%s.%06u\",\"client\":\"%s:%u\",\"method\":\"%s\",\"url\":\"%s\",\"truncated\":%s,"
+               "\"status\":%u,\"bytes\":%lu,\"latency_us\":%u}\n",
+               date, (unsigned)(r.time_us % 1000000), addr, r.port, method, escape(r.url, url_len).c_str(),
+               truncated ? "true" : "false", r.status, (unsigned long)r.bytes, r.latency_us);
+    }
+    else
+    {
+        printf("%s.%06u %s:%u \"%s %.*s%s\" %u %lu %uus\n", date, (unsigned)(r.time_us % 1000000), addr, r.port,
+               method, (int)url_len, r.url, truncated ? "..." : "", r.status, (unsigned long)r.bytes, r.latency_us);
+    }
+}
+
+
+int main(int argc, char * argv[])
+{
+    bool json = false;
+    int opt;
+    while((opt = getopt(argc, argv, "j")) != -1)
+    {
+        if(opt == 'j') json = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [-j] file...\n", argv[0]);
+            return 1;
+        }
+    }
+    if(optind == argc)
+    {
+        fprintf(stderr, "usage: %s [-j] file...\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<access_record> records;
+    int status = 0;
+    for(int i = optind; i < argc; i++) if(!load(argv[i], records)) status = 1;
+
+    std::stable_sort(records.begin(), records.end(), [](const access_record & a, const access_record & b) { return a.time_us < b.time_us; });
+    for(const access_record & r : records) print(r, json);
+    return status;
+}